@@ -0,0 +1,40 @@
+#ifndef TP_ARENA_IMAGE_HPP
+#define TP_ARENA_IMAGE_HPP
+
+#include <vector>
+#include "opencv2/core.hpp"
+
+/**
+ * Arène de tampons à la durée de vie d'une image de la vidéo.
+ *
+ * Chaque appel à obtenir() pendant le traitement d'une image rend le tampon
+ * suivant de l'arène ; nouvelleImage() revient au premier. Comme une image
+ * demande toujours les mêmes tampons dans le même ordre, ils ne sont alloués
+ * qu'aux premières images (ou quand la taille change) puis réutilisés tels
+ * quels. Les données sont allouées par OpenCV, alignées sur 64 octets.
+ */
+class ArenaImage {
+public:
+    void nouvelleImage() {
+        prochain = 0;
+    }
+
+    cv::Mat obtenir(int rows, int cols, int type) {
+        if (prochain == emplacements.size()) {
+            emplacements.push_back(cv::Mat());
+        }
+        cv::Mat &tampon = emplacements[prochain++];
+        tampon.create(rows, cols, type);    // sans effet si la taille n'a pas changé
+        return tampon;
+    }
+
+    cv::Mat obtenir(cv::Size taille, int type) {
+        return obtenir(taille.height, taille.width, type);
+    }
+
+private:
+    std::vector<cv::Mat> emplacements;
+    size_t prochain = 0;
+};
+
+#endif //TP_ARENA_IMAGE_HPP
@@ -0,0 +1,232 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include "opencv2/core.hpp"
+#include "opencv2/imgcodecs.hpp"
+#include "opencv2/imgproc.hpp"
+#include "cache_images.hpp"
+#include "config_execution.hpp"
+#include "convolution_entiere.hpp"
+#include "filtres_tp2.hpp"
+#include "median_constant.hpp"
+#include "traitements_gris.hpp"
+
+using namespace cv;
+
+/** --- OUTILS DE MESURE --- **/
+/* temps moyen (en ms) d'un appel à f sur nbIterations */
+template<typename Fonction>
+double mesurer(Fonction f, int nbIterations) {
+    f(); // échauffement
+    int64 debut = getTickCount();
+    for (int i = 0; i < nbIterations; i++) {
+        f();
+    }
+    return (getTickCount() - debut) * 1000.0 / getTickFrequency() / nbIterations;
+}
+
+/* noyau "tente" séparable de taille n : [1 2 .. r+1 .. 2 1] x [1 2 .. r+1 .. 2 1] / somme */
+Mat noyauTente(int n) {
+    int r = n / 2;
+    Mat k1d(n, 1, CV_32F);
+    float somme = 0.0;
+    for (int i = 0; i < n; i++) {
+        k1d.at<float>(i) = (float) (r + 1 - std::abs(i - r));
+        somme += k1d.at<float>(i);
+    }
+    Mat noyau = k1d * k1d.t();
+    return noyau / (somme * somme);
+}
+
+/** --- CONVOLUTION : filter2D vs convolutionRapide --- **/
+void benchConvolution(const Mat &image, int nbIterations) {
+    std::cout << "Convolution sur " << image.cols << "x" << image.rows << " (CV_8UC1)" << std::endl;
+    std::cout << std::setw(18) << "noyau" << std::setw(14) << "filter2D ms"
+              << std::setw(14) << "entier ms" << std::setw(10) << "gain" << std::setw(12) << "ecart max" << std::endl;
+
+    std::vector<std::pair<String, Mat>> noyaux;
+    noyaux.push_back(std::make_pair(String("filtreM 3x3"), (Mat) (Mat_<float>(3, 3) <<
+            1.0 / 16, 2.0 / 16, 1.0 / 16, 2.0 / 16, 4.0 / 16, 2.0 / 16, 1.0 / 16, 2.0 / 16, 1.0 / 16)));
+    noyaux.push_back(std::make_pair(String("sobelX 3x3"), (Mat) (Mat_<float>(3, 3) <<
+            -1.0 / 4, 0.0, 1.0 / 4, -2.0 / 4, 0.0, 2.0 / 4, -1.0 / 4, 0.0, 1.0 / 4)));
+    noyaux.push_back(std::make_pair(String("rehauss. 3x3"), (Mat) (Mat_<float>(3, 3) <<
+            0.0, -20.0, 0.0, -20.0, 81.0, -20.0, 0.0, -20.0, 0.0)));
+    for (int n = 3; n <= 15; n += 2) {
+        noyaux.push_back(std::make_pair("tente " + std::to_string(n) + "x" + std::to_string(n), noyauTente(n)));
+    }
+
+    for (size_t i = 0; i < noyaux.size(); i++) {
+        const Mat &noyau = noyaux[i].second;
+        Mat sortieRef, sortie;
+
+        double tRef = mesurer([&]() { filter2D(image, sortieRef, -1, noyau); }, nbIterations);
+        double tEntier = mesurer([&]() { convolutionRapide(image, sortie, noyau); }, nbIterations);
+
+        double ecart = norm(sortieRef, sortie, NORM_INF);
+        std::cout << std::setw(18) << noyaux[i].first << std::fixed << std::setprecision(3)
+                  << std::setw(14) << tRef << std::setw(14) << tEntier
+                  << std::setw(9) << std::setprecision(2) << tRef / tEntier << "x"
+                  << std::setw(12) << std::setprecision(0) << ecart << std::endl;
+    }
+}
+
+/** --- MEDIAN : medianBlur vs medianConstant --- **/
+void benchMedian(const Mat &image, int nbIterations) {
+    std::cout << "Median sur " << image.cols << "x" << image.rows << " (CV_8UC1)" << std::endl;
+    std::cout << std::setw(8) << "rayon" << std::setw(16) << "medianBlur ms"
+              << std::setw(14) << "constant ms" << std::setw(10) << "gain" << std::setw(12) << "ecart max" << std::endl;
+
+    int rayons[] = {1, 2, 5, 10, 25, 50};
+    for (int rayon : rayons) {
+        Mat sortieRef, sortie;
+
+        double tRef = mesurer([&]() { medianBlur(image, sortieRef, 2 * rayon + 1); }, nbIterations);
+        double tConstant = mesurer([&]() { medianConstant(image, sortie, rayon); }, nbIterations);
+
+        double ecart = norm(sortieRef, sortie, NORM_INF);
+        std::cout << std::setw(8) << rayon << std::fixed << std::setprecision(3)
+                  << std::setw(16) << tRef << std::setw(14) << tConstant
+                  << std::setw(9) << std::setprecision(2) << tRef / tConstant << "x"
+                  << std::setw(12) << std::setprecision(0) << ecart << std::endl;
+    }
+}
+
+/** --- CHARGEMENT : imread vs chargerImage (cache_images.hpp) --- **/
+void benchCache(const Mat &image, int nbIterations) {
+    // PNG couleur de la taille demandée ; les pixels sont parcourus pour compter aussi les défauts de page
+    Mat couleur;
+    cvtColor(image, couleur, COLOR_GRAY2BGR);
+    const std::string chemin = "/tmp/benchmark_cache.png";
+    imwrite(chemin, couleur);
+
+    Scalar sommeImread, sommeCache;
+    double msImread = mesurer([&]() { sommeImread = sum(imread(chemin, IMREAD_COLOR)); }, nbIterations);
+    double msCache = mesurer([&]() { sommeCache = sum(chargerImage(chemin, IMREAD_COLOR)); }, nbIterations);
+
+    std::cout << "Chargement de " << image.cols << "x" << image.rows << " (PNG, BGR)" << std::endl;
+    std::cout << std::setw(14) << "imread ms" << std::setw(14) << "cache ms" << std::setw(10) << "gain"
+              << std::setw(12) << "identique" << std::endl;
+    std::cout << std::fixed << std::setprecision(2)
+              << std::setw(14) << msImread << std::setw(14) << msCache << std::setw(9) << msImread / msCache << "x"
+              << std::setw(12) << (sommeImread == sommeCache ? "oui" : "non") << std::endl;
+    afficherStatistiquesCache();
+}
+
+/** --- BALAYAGE : backends x nombre de threads (config_execution.hpp) --- **/
+void benchBalayage(const Mat &image, int nbIterations) {
+    ConfigExecution &config = configExecution();
+    const ConfigExecution initiale = config;
+    const int nbThreadsInitial = getNumThreads();
+    const int nbCoeurs = std::max(1, (int) config.coeursAutorises.size());
+
+    // 1, 2, 4... jusqu'au nombre de cœurs autorisés
+    std::vector<int> nbThreads;
+    for (int n = 1; n < nbCoeurs; n *= 2) nbThreads.push_back(n);
+    nbThreads.push_back(nbCoeurs);
+
+    const Mat noyau = noyauTente(7);
+    const int rayon = 5;
+    std::cout << "Balayage sur " << image.cols << "x" << image.rows << " (CV_8UC1, " << nbCoeurs << " cœurs autorisés)"
+              << std::endl;
+    std::cout << std::setw(12) << "backend" << std::setw(10) << "threads" << std::setw(18) << "tente 7x7 ms"
+              << std::setw(18) << "median r=5 ms" << std::endl;
+
+    BackendNoyau backends[] = {BACKEND_REFERENCE, BACKEND_SERIE, BACKEND_PARALLELE};
+    double meilleurConv = 1e30, meilleurMedian = 1e30;
+    std::string choixConv, choixMedian;
+    Mat sortie;
+    for (BackendNoyau backend : backends) {
+        for (size_t i = 0; i < nbThreads.size(); i++) {
+            // le backend serie n'utilise qu'un thread
+            if (backend == BACKEND_SERIE && nbThreads[i] > 1) continue;
+            config.backendConvolution = backend;
+            config.backendMedian = backend;
+            setNumThreads(nbThreads[i]);
+
+            double msConv = mesurer([&]() { convolutionRapide(image, sortie, noyau); }, nbIterations);
+            double msMedian = mesurer([&]() { medianConstant(image, sortie, rayon); }, nbIterations);
+
+            std::string choix = "TP_THREADS=" + std::to_string(nbThreads[i]) + " TP_BACKEND=";
+            if (msConv < meilleurConv) {
+                meilleurConv = msConv;
+                choixConv = choix + "conv=" + nomBackend(backend);
+            }
+            if (msMedian < meilleurMedian) {
+                meilleurMedian = msMedian;
+                choixMedian = choix + "median=" + nomBackend(backend);
+            }
+            std::cout << std::setw(12) << nomBackend(backend) << std::setw(10) << nbThreads[i]
+                      << std::fixed << std::setprecision(3)
+                      << std::setw(18) << msConv << std::setw(18) << msMedian << std::endl;
+        }
+    }
+    std::cout << "meilleure convolution : " << choixConv << " (" << meilleurConv << " ms)" << std::endl;
+    std::cout << "meilleur médian : " << choixMedian << " (" << meilleurMedian << " ms)" << std::endl;
+
+    config = initiale;
+    setNumThreads(nbThreadsInitial);
+}
+
+/** --- COMPTEURS MATERIELS : noyaux du TP1 et du TP2 (compteurs_perf.hpp) --- **/
+void benchPerf(const Mat &image, int nbIterations) {
+    std::cout << "Compteurs matériels sur " << image.cols << "x" << image.rows << " (CV_8UC1), "
+              << nbIterations << " itérations par noyau" << std::endl;
+    const Mat noyau = noyauTente(7);
+    Mat sortie, fs;
+    std::vector<double> hist, histCumule;
+    for (int i = 0; i < nbIterations; i++) histogramme<uchar>(image, hist);
+    histogramme_cumule(hist, histCumule);
+    for (int i = 0; i < nbIterations; i++) equalization<uchar>(image, histCumule, sortie);
+    for (int i = 0; i < nbIterations; i++) tramage_floyd_steinberg<uchar>(image, fs, sortie);
+    ImageIndexee bits;
+    for (int i = 0; i < nbIterations; i++) tramage_floyd_steinberg_indexe<uchar>(image, fs, bits);
+    for (int i = 0; i < nbIterations; i++) gradientFromSobel(image);
+    for (int i = 0; i < nbIterations; i++) convolutionRapide(image, sortie, noyau);
+    for (int i = 0; i < nbIterations; i++) medianConstant(image, sortie, 5);
+    // le tableau est affiché à la sortie du programme
+}
+
+/** --- MAIN --- **/
+int main(int argc, char *argv[]) {
+    // la suite perf active les compteurs avant la création des threads
+    for (int i = 1; i < argc; i++) {
+        if (String(argv[i]) == "perf") setenv("TP_PERF", "1", 1);
+    }
+
+    // threads, affinité et backends (options retirées de argv, config_execution.hpp)
+    configurerExecution(argc, argv);
+
+    if (argc < 2) {
+        std::cout << "\nUsage : ./benchmark <conv | median | cache | sweep | perf> [largeur hauteur] [nbIterations]\n" << std::endl;
+        exit(1);
+    }
+
+    String suite = argv[1];
+    int largeur = (argc > 3) ? atoi(argv[2]) : 1920;
+    int hauteur = (argc > 3) ? atoi(argv[3]) : 1080;
+    int nbIterations = (argc > 4) ? atoi(argv[4]) : 20;
+
+    // image de synthèse reproductible
+    Mat image(hauteur, largeur, CV_8UC1);
+    RNG rng(12345);
+    rng.fill(image, RNG::UNIFORM, 0, 256);
+    GaussianBlur(image, image, Size(5, 5), 1.5);
+
+    std::cout << decrireConfigExecution() << std::endl;
+    if (suite == "conv") {
+        benchConvolution(image, nbIterations);
+    } else if (suite == "median") {
+        benchMedian(image, nbIterations);
+    } else if (suite == "cache") {
+        benchCache(image, nbIterations);
+    } else if (suite == "sweep") {
+        benchBalayage(image, nbIterations);
+    } else if (suite == "perf") {
+        benchPerf(image, nbIterations);
+    } else {
+        std::cout << "\nUsage : ./benchmark <conv | median | cache | sweep | perf> [largeur hauteur] [nbIterations]\n" << std::endl;
+        exit(1);
+    }
+
+    return 0;
+}
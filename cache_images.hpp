@@ -0,0 +1,238 @@
+#ifndef TP_CACHE_IMAGES_HPP
+#define TP_CACHE_IMAGES_HPP
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "opencv2/core.hpp"
+#include "opencv2/imgcodecs.hpp"
+
+/**
+ * Cache des images décodées, à la place de imread.
+ *
+ * Au premier chargement, l'image décodée est écrite à côté du fichier source
+ * (lena.png -> lena.png.<flags>.tpcache) : un en-tête (chemin, date de
+ * modification et taille de la source, flags de imread, format) puis les
+ * pixels, à partir d'une frontière de page et avec des lignes alignées sur 64
+ * octets. Les chargements suivants projettent ce fichier en mémoire (mmap
+ * privé) au lieu de décoder : rien n'est lu avant le premier accès aux
+ * pixels, et les pages restent partagées entre les processus qui lisent la
+ * même image. Une image modifiée sur place est copiée page par page, sans
+ * toucher au fichier.
+ *
+ * Chaque chargement a sa propre projection, comme imread rend une image
+ * neuve : deux chargements du même fichier ne partagent pas leurs pixels.
+ * Elle appartient à l'image rendue et à ses copies (AllocateurProjection) et
+ * est libérée (munmap) quand la dernière est détruite. TP_CACHE=0 désactive
+ * le cache.
+ */
+
+struct EnteteCache {
+    char magique[8];                // "TPCACHE1"
+    char source[PATH_MAX];          // chemin absolu de la source
+    int64_t mtimeSec;
+    int64_t mtimeNsec;
+    int64_t tailleSource;
+    int32_t flags;                  // flags de imread
+    int32_t rows;
+    int32_t cols;
+    int32_t type;
+    int64_t step;
+    int64_t debutPixels;
+    double dureeDecodageMs;         // temps économisé à chaque succès
+};
+
+struct StatistiquesCache {
+    std::atomic<long long> succes{0};
+    std::atomic<long long> echecs{0};
+    std::atomic<long long> microsecondesEconomisees{0};
+};
+
+inline StatistiquesCache &statistiquesCache() {
+    static StatistiquesCache statistiques;
+    return statistiques;
+}
+
+inline void afficherStatistiquesCache() {
+    StatistiquesCache &s = statistiquesCache();
+    long long total = s.succes + s.echecs;
+    std::cout << "cache images : " << s.succes << " succès, " << s.echecs << " échecs ("
+              << (total > 0 ? 100.0 * s.succes / total : 0.0) << " %), "
+              << s.microsecondesEconomisees / 1000.0 << " ms de décodage évitées" << std::endl;
+}
+
+/** --- PROJECTIONS --- **/
+/**
+ * Propriétaire d'une projection pour les Mat qui la partagent : le compteur de
+ * références de la Mat décide du munmap, comme pour une image allouée par
+ * OpenCV. Il n'alloue jamais lui-même.
+ */
+class AllocateurProjection : public cv::MatAllocator {
+public:
+#if CV_VERSION_MAJOR >= 4
+    typedef cv::AccessFlag Acces;
+#else
+    typedef int Acces;
+#endif
+
+    cv::UMatData *allocate(int, const int *, int, void *, size_t *, Acces, cv::UMatUsageFlags) const override {
+        return nullptr;
+    }
+
+    bool allocate(cv::UMatData *, Acces, cv::UMatUsageFlags) const override {
+        return false;
+    }
+
+    void deallocate(cv::UMatData *u) const override {
+        if (u == nullptr) return;
+        munmap(u->origdata, u->size);
+        delete u;
+    }
+
+    /* image sur les pixels de la projection [adresse, adresse + taille), qui lui appartient désormais */
+    cv::Mat image(void *adresse, size_t taille, int rows, int cols, int type, size_t debut, size_t step) const {
+        cv::Mat image(rows, cols, type, (uchar *) adresse + debut, step);
+        cv::UMatData *u = new cv::UMatData(this);
+        u->data = u->origdata = (uchar *) adresse;
+        u->size = taille;
+        u->refcount = 1;
+        image.u = u;
+        return image;
+    }
+};
+
+inline const AllocateurProjection &allocateurProjection() {
+    static AllocateurProjection allocateur;
+    return allocateur;
+}
+
+inline bool enteteCorrespond(const EnteteCache &entete, const std::string &source, const struct stat &infos,
+                             int flags) {
+    return memcmp(entete.magique, "TPCACHE1", 8) == 0 && source == entete.source
+           && entete.mtimeSec == (int64_t) infos.st_mtim.tv_sec && entete.mtimeNsec == (int64_t) infos.st_mtim.tv_nsec
+           && entete.tailleSource == (int64_t) infos.st_size && entete.flags == flags;
+}
+
+/**
+ * Image du fichier de cache s'il correspond à la source (et son temps de
+ * décodage), faux sinon. Chaque appel projette le fichier à nouveau : les
+ * images rendues ne partagent jamais leurs pixels, et celle qu'on modifie est
+ * copiée page par page à la première écriture (mmap privé), sans toucher aux
+ * autres ni au fichier.
+ */
+inline bool lireCache(const std::string &cheminCache, const std::string &source, const struct stat &infos, int flags,
+                      cv::Mat &image, double &dureeDecodageMs) {
+    int fd = open(cheminCache.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat infosCache;
+    EnteteCache entete;
+    bool ok = fstat(fd, &infosCache) == 0 && pread(fd, &entete, sizeof(entete), 0) == (ssize_t) sizeof(entete);
+    // fichier éventuellement corrompu : le chemin doit rester une chaîne terminée
+    entete.source[sizeof(entete.source) - 1] = 0;
+    ok = ok && enteteCorrespond(entete, source, infos, flags)
+         && infosCache.st_size >= entete.debutPixels + entete.step * entete.rows;
+    void *adresse = MAP_FAILED;
+    if (ok) {
+        adresse = mmap(nullptr, infosCache.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (adresse == MAP_FAILED) return false;
+
+    // la projection appartient à l'image : munmap quand sa dernière copie (Mat) est détruite
+    image = allocateurProjection().image(adresse, infosCache.st_size, entete.rows, entete.cols, entete.type,
+                                         entete.debutPixels, entete.step);
+    dureeDecodageMs = entete.dureeDecodageMs;
+    return true;
+}
+
+/* écrit image dans le fichier de cache (fichier temporaire puis renommage, pour les lecteurs concurrents) */
+inline void ecrireCache(const std::string &cheminCache, const std::string &source, const struct stat &infos,
+                        int flags, const cv::Mat &image, double dureeDecodageMs) {
+    EnteteCache entete;
+    memset(&entete, 0, sizeof(entete));
+    memcpy(entete.magique, "TPCACHE1", 8);
+    snprintf(entete.source, sizeof(entete.source), "%s", source.c_str());
+    entete.mtimeSec = infos.st_mtim.tv_sec;
+    entete.mtimeNsec = infos.st_mtim.tv_nsec;
+    entete.tailleSource = infos.st_size;
+    entete.flags = flags;
+    entete.rows = image.rows;
+    entete.cols = image.cols;
+    entete.type = image.type();
+    entete.step = ((int64_t) image.cols * image.elemSize() + 63) / 64 * 64;
+    entete.debutPixels = ((int64_t) sizeof(EnteteCache) + 4095) / 4096 * 4096;
+    entete.dureeDecodageMs = dureeDecodageMs;
+
+    // nom unique par appel : plusieurs threads ou processus peuvent écrire le même cache en même temps
+    std::vector<char> temporaire(cheminCache.begin(), cheminCache.end());
+    const char suffixe[] = ".XXXXXX";
+    temporaire.insert(temporaire.end(), suffixe, suffixe + sizeof(suffixe));
+    int fd = mkstemp(temporaire.data());
+    if (fd < 0) return;                 // répertoire en lecture seule : pas de cache
+    fchmod(fd, 0644);
+    FILE *fichier = fdopen(fd, "wb");
+    if (fichier == nullptr) {
+        close(fd);
+        unlink(temporaire.data());
+        return;
+    }
+
+    bool ok = fwrite(&entete, sizeof(entete), 1, fichier) == 1
+              && fseek(fichier, (long) entete.debutPixels, SEEK_SET) == 0;
+    std::vector<uchar> ligne(entete.step, 0);
+    const size_t octetsParLigne = image.cols * image.elemSize();
+    for (int i = 0; ok && i < image.rows; i++) {
+        memcpy(ligne.data(), image.ptr(i), octetsParLigne);
+        ok = fwrite(ligne.data(), 1, ligne.size(), fichier) == ligne.size();
+    }
+    ok = (fclose(fichier) == 0) && ok;
+
+    if (!ok || rename(temporaire.data(), cheminCache.c_str()) != 0) {
+        unlink(temporaire.data());
+    }
+}
+
+/** --- CHARGEMENT --- **/
+/* comme imread(chemin, flags), en passant par le cache ; image vide si le fichier est illisible */
+inline cv::Mat chargerImage(const std::string &chemin, int flags = cv::IMREAD_COLOR) {
+    const char *active = getenv("TP_CACHE");
+    char source[PATH_MAX];
+    struct stat infos;
+    if ((active != nullptr && std::string(active) == "0") || realpath(chemin.c_str(), source) == nullptr
+        || stat(source, &infos) != 0) {
+        return cv::imread(chemin, flags);
+    }
+
+    const std::string cheminCache = std::string(source) + "." + std::to_string(flags) + ".tpcache";
+    StatistiquesCache &statistiques = statistiquesCache();
+
+    cv::Mat image;
+    double dureeDecodageMs = 0.0;
+    if (lireCache(cheminCache, source, infos, flags, image, dureeDecodageMs)) {
+        statistiques.succes++;
+        statistiques.microsecondesEconomisees += (long long) (dureeDecodageMs * 1000.0);
+        return image;
+    }
+
+    int64 debut = cv::getTickCount();
+    image = cv::imread(source, flags);
+    dureeDecodageMs = (cv::getTickCount() - debut) * 1000.0 / cv::getTickFrequency();
+    statistiques.echecs++;
+    if (!image.empty()) {
+        ecrireCache(cheminCache, source, infos, flags, image, dureeDecodageMs);
+    }
+    return image;
+}
+
+#endif //TP_CACHE_IMAGES_HPP
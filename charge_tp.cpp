@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "opencv2/imgcodecs.hpp"
+#include "config_execution.hpp"
+#include "protocole_tp.hpp"
+
+using namespace cv;
+
+/**
+ * Générateur de charge pour le serveur de traitements : plusieurs clients
+ * (une connexion et un thread chacun) envoient la même requête en boucle.
+ * Affiche le débit (requêtes par seconde) et la latence aller-retour
+ * (médiane, 99e centile, maximum) mesurée côté client.
+ */
+
+void usage() {
+    std::cout << "\nUsage : ./charge_tp <image> <chaine, ex. a,s,g,t> [--clients <n>] [--requetes <par client>]"
+              << "\n        [--socket <chemin>] [--memoire] [--couleur]"
+              << "\n        [--params <alpha>,<seuil>,<rayon>,<proportion>,<longueur>]\n"
+              << std::endl;
+    exit(1);
+}
+
+/* latences en ms des requêtes d'un client, vide si la connexion échoue */
+void lancerClient(const std::string &cheminSocket, RequeteTP requete, const Mat &image, int nbRequetes,
+                  std::vector<double> &latences) {
+    ClientTP client;
+    if (!client.connecter(cheminSocket)) return;
+    if (!image.empty() && !client.preparerEntree(image, requete)) return;
+
+    ReponseTP reponse;
+    Mat resultat;
+    for (int i = 0; i < nbRequetes; i++) {
+        int64 debut = getTickCount();
+        if (!client.traiter(requete, reponse, resultat)) {
+            std::cout << "Erreur : " << reponse.message << std::endl;
+            return;
+        }
+        latences.push_back((getTickCount() - debut) * 1000.0 / getTickFrequency());
+    }
+}
+
+double centile(const std::vector<double> &triees, double p) {
+    size_t i = (size_t) (p / 100.0 * (triees.size() - 1) + 0.5);
+    return triees[std::min(i, triees.size() - 1)];
+}
+
+int main(int argc, char *argv[]) {
+    // threads, affinité et backends (options retirées de argv, config_execution.hpp)
+    configurerExecution(argc, argv);
+
+    if (argc < 3) usage();
+
+    RequeteTP requete;
+    std::string cheminSocket = cheminSocketDefaut();
+    bool memoire = false;
+    int nbClients = 4;
+    int nbRequetes = 100;
+    snprintf(requete.chaine, sizeof(requete.chaine), "%s", argv[2]);
+
+    for (int i = 3; i < argc; i++) {
+        String option = argv[i];
+        if (option == "--clients" && i + 1 < argc) {
+            nbClients = std::max(1, atoi(argv[++i]));
+        } else if (option == "--requetes" && i + 1 < argc) {
+            nbRequetes = std::max(1, atoi(argv[++i]));
+        } else if (!lireOptionClient(argc, argv, i, requete, cheminSocket, memoire)) {
+            usage();
+        }
+    }
+
+    // chaque client copie l'image dans son propre segment d'entrée
+    Mat image;
+    if (memoire) {
+        image = imread(argv[1], requete.canaux == 3 ? IMREAD_COLOR : IMREAD_GRAYSCALE);
+        if (image.empty()) {
+            std::cout << "Impossible de lire " << argv[1] << std::endl;
+            return 1;
+        }
+    } else {
+        char chemin[PATH_MAX];
+        if (realpath(argv[1], chemin) == nullptr) {
+            std::cout << "Impossible de lire " << argv[1] << std::endl;
+            return 1;
+        }
+        snprintf(requete.chemin, sizeof(requete.chemin), "%s", chemin);
+    }
+
+    // une première requête pour que le serveur ait décodé l'image et construit la chaîne
+    std::vector<double> echauffement;
+    lancerClient(cheminSocket, requete, image, 1, echauffement);
+    if (echauffement.empty()) {
+        std::cout << "Serveur absent sur " << cheminSocket << " (lancer ./serveur_tp)" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::vector<double>> latencesClients(nbClients);
+    std::vector<std::thread> clients;
+    int64 debut = getTickCount();
+    for (int c = 0; c < nbClients; c++) {
+        clients.push_back(std::thread(lancerClient, std::cref(cheminSocket), requete, std::cref(image), nbRequetes,
+                                      std::ref(latencesClients[c])));
+    }
+    for (size_t c = 0; c < clients.size(); c++) clients[c].join();
+    double duree = (getTickCount() - debut) / getTickFrequency();
+
+    std::vector<double> latences;
+    for (int c = 0; c < nbClients; c++) {
+        latences.insert(latences.end(), latencesClients[c].begin(), latencesClients[c].end());
+    }
+    if (latences.empty()) return 1;
+    std::sort(latences.begin(), latences.end());
+
+    std::cout << requete.chaine << " (" << nbClients << " clients" << (memoire ? ", mémoire partagée" : "")
+              << ") : " << latences.size() / duree << " requêtes/s, latence p50 " << centile(latences, 50)
+              << " ms, p99 " << centile(latences, 99) << " ms, max " << latences.back() << " ms" << std::endl;
+    return 0;
+}
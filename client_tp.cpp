@@ -0,0 +1,83 @@
+#include <iostream>
+#include <climits>
+#include <cstdlib>
+#include "opencv2/imgcodecs.hpp"
+#include "config_execution.hpp"
+#include "protocole_tp.hpp"
+
+using namespace cv;
+
+/**
+ * Client du serveur de traitements : envoie une requête, affiche sa durée et
+ * écrit le résultat si un fichier de sortie est donné. Sans --memoire, c'est
+ * le serveur qui lit (et garde) l'image ; avec --memoire, le client la décode
+ * et la passe en mémoire partagée. Avec --couleur, l'image est traitée en BGR
+ * par les étapes de main_color_img.
+ */
+
+void usage() {
+    std::cout << "\nUsage : ./client_tp <image> <chaine, ex. a,s,g,t> [sortie.png] [--socket <chemin>] [--memoire]"
+              << "\n        [--couleur] [--params <alpha>,<seuil>,<rayon>,<proportion>,<longueur>]\n" << std::endl;
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    // threads, affinité et backends (options retirées de argv, config_execution.hpp)
+    configurerExecution(argc, argv);
+
+    if (argc < 3) usage();
+
+    RequeteTP requete;
+    std::string cheminSocket = cheminSocketDefaut();
+    bool memoire = false;
+    String sortie;
+    snprintf(requete.chaine, sizeof(requete.chaine), "%s", argv[2]);
+
+    for (int i = 3; i < argc; i++) {
+        if (argv[i][0] != '-' && sortie.empty()) {
+            sortie = argv[i];
+        } else if (!lireOptionClient(argc, argv, i, requete, cheminSocket, memoire)) {
+            usage();
+        }
+    }
+
+    ClientTP client;
+    if (!client.connecter(cheminSocket)) {
+        std::cout << "Serveur absent sur " << cheminSocket << " (lancer ./serveur_tp)" << std::endl;
+        return 1;
+    }
+
+    if (memoire) {
+        Mat image = imread(argv[1], requete.canaux == 3 ? IMREAD_COLOR : IMREAD_GRAYSCALE);
+        if (image.empty() || !client.preparerEntree(image, requete)) {
+            std::cout << "Impossible de lire " << argv[1] << std::endl;
+            return 1;
+        }
+    } else {
+        // le serveur ne partage pas le répertoire courant du client
+        char chemin[PATH_MAX];
+        if (realpath(argv[1], chemin) == nullptr) {
+            std::cout << "Impossible de lire " << argv[1] << std::endl;
+            return 1;
+        }
+        snprintf(requete.chemin, sizeof(requete.chemin), "%s", chemin);
+    }
+
+    int64 debut = getTickCount();
+    ReponseTP reponse;
+    Mat resultat;
+    if (!client.traiter(requete, reponse, resultat)) {
+        std::cout << "Erreur : " << reponse.message << std::endl;
+        return 1;
+    }
+    double total = (getTickCount() - debut) * 1000.0 / getTickFrequency();
+
+    std::cout << requete.chaine << " sur " << resultat.cols << "x" << resultat.rows << " : " << reponse.dureeMs
+              << " ms de traitement, " << total << " ms aller-retour" << std::endl;
+
+    if (!sortie.empty() && !imwrite(sortie, resultat)) {
+        std::cout << "Impossible d'écrire " << sortie << std::endl;
+        return 1;
+    }
+    return 0;
+}
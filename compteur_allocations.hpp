@@ -0,0 +1,45 @@
+#ifndef TP_COMPTEUR_ALLOCATIONS_HPP
+#define TP_COMPTEUR_ALLOCATIONS_HPP
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+/**
+ * Compteur d'allocations sur le tas.
+ *
+ * Remplace operator new / delete pour tout le programme : à n'inclure que
+ * dans un seul fichier par exécutable. Chaque allocation de données d'une Mat
+ * passe aussi par new (création de son UMatData), elle est donc comptée.
+ */
+
+std::atomic<long long> nbAllocations(0);
+
+void *operator new(std::size_t taille) {
+    nbAllocations++;
+    void *p = std::malloc(taille > 0 ? taille : 1);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](std::size_t taille) {
+    return operator new(taille);
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+#endif //TP_COMPTEUR_ALLOCATIONS_HPP
@@ -0,0 +1,226 @@
+#ifndef TP_COMPTEURS_PERF_HPP
+#define TP_COMPTEURS_PERF_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "opencv2/core.hpp"
+
+/**
+ * Compteurs matériels (perf_event_open) autour des noyaux d'image.
+ *
+ * Activé par --perf ou TP_PERF=1 (config_execution.hpp), avant la création
+ * des threads : les compteurs sont ouverts pour le processus avec héritage,
+ * et la lecture additionne ceux de tous les threads créés ensuite (pool
+ * d'OpenCV compris). Une MesurePerf lit les compteurs à sa construction et à
+ * sa destruction et cumule la différence sous le nom du noyau ; le tableau
+ * par pixel est affiché à la fin du programme. Les mesures imbriquées
+ * comptent aussi leurs sous-noyaux, et deux mesures simultanées dans deux
+ * threads comptent le travail de l'autre : les résultats ne sont nets que
+ * quand les noyaux mesurés s'exécutent un à la fois. Pour cette raison, les
+ * bandes qu'une mesure répartit sur le pool (moteur de pipeline) sont
+ * exécutées sous BandesSansMesure : les noyaux appelés bande par bande ne sont
+ * pas mesurés séparément, seule la suite d'étapes qui les englobe l'est.
+ *
+ * La bande passante mémoire est estimée par défauts LLC x 64 octets / durée.
+ * Sans compteurs (perf_event_paranoid, machine virtuelle, autre système), un
+ * message l'indique et seule la durée par pixel est affichée. Désactivée, une
+ * MesurePerf ne coûte qu'un test.
+ */
+
+enum CompteurPerf {
+    PERF_CYCLES, PERF_INSTRUCTIONS, PERF_DEFAUTS_L1, PERF_DEFAUTS_LLC, PERF_DEFAUTS_BRANCHEMENT, NB_COMPTEURS_PERF
+};
+
+struct ValeursPerf {
+    double compteurs[NB_COMPTEURS_PERF] = {};
+    int64 ticks = 0;
+};
+
+struct CumulPerf {
+    long long appels = 0;
+    double pixels = 0.0;
+    double compteurs[NB_COMPTEURS_PERF] = {};
+    double ms = 0.0;
+};
+
+struct EtatCompteursPerf {
+    bool actif = false;
+    int fd[NB_COMPTEURS_PERF] = {-1, -1, -1, -1, -1};
+    std::mutex verrou;
+    std::map<std::string, CumulPerf> cumuls;   // par nom de noyau
+};
+
+inline EtatCompteursPerf &etatCompteursPerf() {
+    static EtatCompteursPerf etat;
+    return etat;
+}
+
+inline bool compteursPerfActifs() {
+    return etatCompteursPerf().actif;
+}
+
+/* nombre de BandesSansMesure en cours dans le thread courant */
+inline int &profondeurBandesPerf() {
+    static thread_local int profondeur = 0;
+    return profondeur;
+}
+
+/* pendant sa portée, le thread courant exécute une bande d'une mesure englobante : ses MesurePerf sont ignorées */
+class BandesSansMesure {
+public:
+    BandesSansMesure() {
+        profondeurBandesPerf()++;
+    }
+
+    ~BandesSansMesure() {
+        profondeurBandesPerf()--;
+    }
+
+    BandesSansMesure(const BandesSansMesure &) = delete;
+    BandesSansMesure &operator=(const BandesSansMesure &) = delete;
+};
+
+/* compteur du processus et des threads qu'il créera, en mode utilisateur ; -1 si indisponible */
+inline int ouvrirCompteurPerf(uint32_t type, uint64_t config) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/* valeurs courantes, corrigées du multiplexage ; -1 pour un compteur indisponible */
+inline void lireCompteursPerf(ValeursPerf &valeurs) {
+    EtatCompteursPerf &etat = etatCompteursPerf();
+    for (int i = 0; i < NB_COMPTEURS_PERF; i++) {
+        uint64_t lu[3];     // valeur, temps activé, temps compté
+        valeurs.compteurs[i] = -1.0;
+        if (etat.fd[i] >= 0 && read(etat.fd[i], lu, sizeof(lu)) == (ssize_t) sizeof(lu) && lu[2] > 0) {
+            valeurs.compteurs[i] = (double) lu[0] * ((double) lu[1] / (double) lu[2]);
+        }
+    }
+    valeurs.ticks = cv::getTickCount();
+}
+
+inline void afficherCompteursPerf() {
+    EtatCompteursPerf &etat = etatCompteursPerf();
+    std::lock_guard<std::mutex> garde(etat.verrou);
+    if (etat.cumuls.empty()) return;
+
+    const char *entetes[NB_COMPTEURS_PERF] = {"cycles/px", "instr/px", "def.L1/px", "def.LLC/px", "def.branch/px"};
+    std::cout << "Compteurs matériels par pixel :" << std::endl;
+    std::cout << std::setw(40) << "noyau" << std::setw(8) << "appels" << std::setw(10) << "Mpixels"
+              << std::setw(10) << "ns/px";
+    for (int i = 0; i < NB_COMPTEURS_PERF; i++) std::cout << std::setw(14) << entetes[i];
+    std::cout << std::setw(8) << "IPC" << std::setw(8) << "Go/s" << std::endl;
+
+    for (auto it = etat.cumuls.begin(); it != etat.cumuls.end(); ++it) {
+        const CumulPerf &c = it->second;
+        const double pixels = std::max(c.pixels, 1.0);
+        std::cout << std::setw(40) << it->first << std::setw(8) << c.appels << std::fixed << std::setprecision(2)
+                  << std::setw(10) << c.pixels / 1e6 << std::setw(10) << c.ms * 1e6 / pixels << std::setprecision(4);
+        for (int i = 0; i < NB_COMPTEURS_PERF; i++) {
+            if (c.compteurs[i] >= 0.0) std::cout << std::setw(14) << c.compteurs[i] / pixels;
+            else std::cout << std::setw(14) << "-";
+        }
+        std::cout << std::setprecision(2);
+        if (c.compteurs[PERF_CYCLES] > 0.0 && c.compteurs[PERF_INSTRUCTIONS] >= 0.0) {
+            std::cout << std::setw(8) << c.compteurs[PERF_INSTRUCTIONS] / c.compteurs[PERF_CYCLES];
+        } else {
+            std::cout << std::setw(8) << "-";
+        }
+        if (c.compteurs[PERF_DEFAUTS_LLC] >= 0.0 && c.ms > 0.0) {
+            std::cout << std::setw(8) << c.compteurs[PERF_DEFAUTS_LLC] * 64.0 / (c.ms * 1e6);
+        } else {
+            std::cout << std::setw(8) << "-";
+        }
+        std::cout << std::defaultfloat << std::endl;
+    }
+}
+
+/* ouvre les compteurs et affiche le tableau à la sortie ; à appeler avant la création des threads */
+inline void activerCompteursPerf() {
+    EtatCompteursPerf &etat = etatCompteursPerf();
+    if (etat.actif) return;
+    etat.actif = true;
+
+    const uint64_t defautL1 = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                              | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    const uint32_t types[NB_COMPTEURS_PERF] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+                                               PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE};
+    const uint64_t configs[NB_COMPTEURS_PERF] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, defautL1,
+                                                 PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    int erreur = 0;     // cause du premier échec, la plus parlante
+    int nbOuverts = 0;
+    for (int i = 0; i < NB_COMPTEURS_PERF; i++) {
+        etat.fd[i] = ouvrirCompteurPerf(types[i], configs[i]);
+        if (etat.fd[i] < 0 && erreur == 0) erreur = errno;
+        nbOuverts += (etat.fd[i] >= 0);
+    }
+    if (nbOuverts == 0) {
+        std::cout << "Compteurs matériels indisponibles (" << strerror(erreur)
+                  << ", voir /proc/sys/kernel/perf_event_paranoid) : seule la durée est mesurée" << std::endl;
+    }
+    atexit(afficherCompteursPerf);
+}
+
+inline void cumulerMesurePerf(const std::string &nom, double nbPixels, const ValeursPerf &debut,
+                              const ValeursPerf &fin) {
+    EtatCompteursPerf &etat = etatCompteursPerf();
+    std::lock_guard<std::mutex> garde(etat.verrou);
+    CumulPerf &cumul = etat.cumuls[nom];
+    if (cumul.appels == 0) {
+        for (int i = 0; i < NB_COMPTEURS_PERF; i++) cumul.compteurs[i] = (debut.compteurs[i] < 0.0) ? -1.0 : 0.0;
+    }
+    cumul.appels++;
+    cumul.pixels += nbPixels;
+    cumul.ms += (fin.ticks - debut.ticks) * 1000.0 / cv::getTickFrequency();
+    for (int i = 0; i < NB_COMPTEURS_PERF; i++) {
+        if (cumul.compteurs[i] >= 0.0) cumul.compteurs[i] += fin.compteurs[i] - debut.compteurs[i];
+    }
+}
+
+/* mesure la portée courante sous le nom du noyau (nom copié seulement si les compteurs sont actifs) */
+class MesurePerf {
+public:
+    MesurePerf(const char *nom, double nbPixels) : actif(compteursPerfActifs() && profondeurBandesPerf() == 0) {
+        if (!actif) return;
+        this->nom = nom;
+        this->nbPixels = nbPixels;
+        lireCompteursPerf(debut);
+    }
+
+    ~MesurePerf() {
+        if (!actif) return;
+        ValeursPerf fin;
+        lireCompteursPerf(fin);
+        cumulerMesurePerf(nom, nbPixels, debut, fin);
+    }
+
+    MesurePerf(const MesurePerf &) = delete;
+    MesurePerf &operator=(const MesurePerf &) = delete;
+
+private:
+    bool actif;
+    std::string nom;
+    double nbPixels = 0.0;
+    ValeursPerf debut;
+};
+
+#endif //TP_COMPTEURS_PERF_HPP
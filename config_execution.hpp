@@ -0,0 +1,270 @@
+#ifndef TP_CONFIG_EXECUTION_HPP
+#define TP_CONFIG_EXECUTION_HPP
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sched.h>
+#include "opencv2/core.hpp"
+#include "compteurs_perf.hpp"
+
+/**
+ * Configuration d'exécution commune à tous les programmes, lue dans
+ * l'environnement puis sur la ligne de commande (qui l'emporte) :
+ *
+ *   --threads <n>        TP_THREADS      threads du pool d'OpenCV (et de l'ordonnanceur de main_video)
+ *   --affinite <cœurs>   TP_AFFINITE     cœurs autorisés, ex. 0-3,8
+ *   --epingler           TP_EPINGLER=1   chaque thread de l'ordonnanceur reste sur un seul cœur
+ *   --numa <nœud>        TP_NUMA         seulement les cœurs de ce nœud NUMA
+ *   --backend <b>        TP_BACKEND      reference, serie ou parallele, pour tous les noyaux ou
+ *                                        par noyau (ex. conv=serie,median=parallele)
+ *   --perf               TP_PERF=1       compteurs matériels par noyau (compteurs_perf.hpp)
+ *
+ * Le masque d'affinité est posé sur le thread principal avant la création de
+ * tout autre thread : le pool d'OpenCV et les threads des programmes en
+ * héritent. Sans --threads, le pool prend un thread par cœur autorisé.
+ * Il n'y a pas de placement mémoire explicite : Linux place une page sur le
+ * nœud du thread qui la touche en premier, et les tampons (arènes, pools) sont
+ * remplis par les threads qui les utilisent. Restreindre les cœurs à un nœud
+ * garde donc les images et les tampons sur la mémoire de ce nœud.
+ *
+ * Backends : reference = fonction d'OpenCV (filter2D, medianBlur), serie =
+ * noyau du projet sur un seul thread, parallele = noyau du projet découpé en
+ * bandes sur le pool (par défaut). Les noyaux du projet utilisent toujours les
+ * intrinsèques universelles d'OpenCV : serie et parallele ne diffèrent que par
+ * le nombre de threads.
+ */
+
+enum BackendNoyau { BACKEND_REFERENCE, BACKEND_SERIE, BACKEND_PARALLELE };
+
+struct ConfigExecution {
+    int nbThreads = 0;                          // 0 : un par cœur autorisé
+    std::vector<int> coeurs;                    // vide : tous les cœurs
+    bool epingler = false;
+    bool perf = false;
+    int noeudNuma = -1;
+    BackendNoyau backendConvolution = BACKEND_PARALLELE;
+    BackendNoyau backendMedian = BACKEND_PARALLELE;
+    std::vector<int> coeursAutorises;           // masque effectif, après application
+};
+
+inline ConfigExecution &configExecution() {
+    static ConfigExecution config;
+    return config;
+}
+
+inline const char *nomBackend(BackendNoyau backend) {
+    switch (backend) {
+        case BACKEND_REFERENCE: return "reference";
+        case BACKEND_SERIE: return "serie";
+        default: return "parallele";
+    }
+}
+
+/* "0-3,8" -> {0, 1, 2, 3, 8} ; faux si la liste est mal formée */
+inline bool analyserListeCoeurs(const std::string &liste, std::vector<int> &coeurs) {
+    coeurs.clear();
+    size_t debut = 0;
+    while (debut < liste.size()) {
+        size_t fin = liste.find(',', debut);
+        if (fin == std::string::npos) fin = liste.size();
+        std::string plage = liste.substr(debut, fin - debut);
+        int premier, dernier;
+        char reste;
+        if (sscanf(plage.c_str(), "%d-%d%c", &premier, &dernier, &reste) != 2) {
+            if (sscanf(plage.c_str(), "%d%c", &premier, &reste) != 1) return false;
+            dernier = premier;
+        }
+        if (premier < 0 || dernier < premier || dernier >= CPU_SETSIZE) return false;
+        for (int c = premier; c <= dernier; c++) coeurs.push_back(c);
+        debut = fin + 1;
+    }
+    return !coeurs.empty();
+}
+
+/* cœurs du nœud NUMA d'après sysfs ; faux si le nœud n'existe pas */
+inline bool coeursNoeudNuma(int noeud, std::vector<int> &coeurs) {
+    std::ifstream fichier("/sys/devices/system/node/node" + std::to_string(noeud) + "/cpulist");
+    std::string liste;
+    if (!std::getline(fichier, liste)) return false;
+    liste.erase(liste.find_last_not_of(" \n") + 1);
+    return analyserListeCoeurs(liste, coeurs);
+}
+
+/* "parallele" (tous les noyaux) ou "conv=serie,median=reference" */
+inline bool analyserBackends(const std::string &valeur, ConfigExecution &config) {
+    size_t debut = 0;
+    while (debut < valeur.size()) {
+        size_t fin = valeur.find(',', debut);
+        if (fin == std::string::npos) fin = valeur.size();
+        std::string element = valeur.substr(debut, fin - debut);
+        size_t egal = element.find('=');
+        std::string noyau = (egal == std::string::npos) ? "" : element.substr(0, egal);
+        std::string nom = element.substr(egal == std::string::npos ? 0 : egal + 1);
+
+        BackendNoyau backend;
+        if (nom == "reference") backend = BACKEND_REFERENCE;
+        else if (nom == "serie") backend = BACKEND_SERIE;
+        else if (nom == "parallele") backend = BACKEND_PARALLELE;
+        else return false;
+
+        if (noyau.empty() || noyau == "conv") config.backendConvolution = backend;
+        if (noyau.empty() || noyau == "median") config.backendMedian = backend;
+        if (!noyau.empty() && noyau != "conv" && noyau != "median") return false;
+        debut = fin + 1;
+    }
+    return true;
+}
+
+/* une option de configuration (nom de l'option longue) ; faux si la valeur est invalide */
+inline bool lireValeurConfig(const std::string &option, const std::string &valeur, ConfigExecution &config) {
+    if (option == "--threads") {
+        config.nbThreads = atoi(valeur.c_str());
+        return config.nbThreads > 0;
+    } else if (option == "--affinite") {
+        return analyserListeCoeurs(valeur, config.coeurs);
+    } else if (option == "--epingler") {
+        config.epingler = (valeur != "0");
+        return true;
+    } else if (option == "--perf") {
+        config.perf = (valeur != "0");
+        return true;
+    } else if (option == "--numa") {
+        config.noeudNuma = atoi(valeur.c_str());
+        return config.noeudNuma >= 0;
+    } else if (option == "--backend") {
+        return analyserBackends(valeur, config);
+    }
+    return false;
+}
+
+/* pose le masque d'affinité du thread courant, puis la taille du pool d'OpenCV */
+inline bool appliquerConfigExecution(ConfigExecution &config, std::string &erreur) {
+    std::vector<int> coeurs = config.coeurs;
+    if (config.noeudNuma >= 0) {
+        std::vector<int> noeud;
+        if (!coeursNoeudNuma(config.noeudNuma, noeud)) {
+            erreur = "nœud NUMA " + std::to_string(config.noeudNuma) + " absent";
+            return false;
+        }
+        if (coeurs.empty()) {
+            coeurs = noeud;
+        } else {
+            std::vector<int> communs;
+            for (size_t i = 0; i < coeurs.size(); i++) {
+                if (std::find(noeud.begin(), noeud.end(), coeurs[i]) != noeud.end()) communs.push_back(coeurs[i]);
+            }
+            coeurs = communs;
+            if (coeurs.empty()) {
+                erreur = "aucun des cœurs demandés n'est sur le nœud NUMA " + std::to_string(config.noeudNuma);
+                return false;
+            }
+        }
+    }
+
+    cpu_set_t masque;
+    if (!coeurs.empty()) {
+        CPU_ZERO(&masque);
+        for (size_t i = 0; i < coeurs.size(); i++) CPU_SET(coeurs[i], &masque);
+        if (sched_setaffinity(0, sizeof(masque), &masque) != 0) {
+            erreur = "aucun des cœurs demandés n'est disponible";
+            return false;
+        }
+    }
+    if (sched_getaffinity(0, sizeof(masque), &masque) != 0) CPU_ZERO(&masque);
+    config.coeursAutorises.clear();
+    for (int c = 0; c < CPU_SETSIZE; c++) {
+        if (CPU_ISSET(c, &masque)) config.coeursAutorises.push_back(c);
+    }
+
+    int nbThreads = config.nbThreads;
+    if (nbThreads == 0 && !coeurs.empty()) nbThreads = (int) config.coeursAutorises.size();
+    if (nbThreads > 0) cv::setNumThreads(nbThreads);
+    return true;
+}
+
+/**
+ * Lit la configuration (environnement puis argv) et l'applique. Les options
+ * reconnues sont retirées de argv, qui reste terminé par nullptr ; à appeler
+ * en tête de main, avant la création de tout thread.
+ */
+inline void configurerExecution(int &argc, char *argv[]) {
+    ConfigExecution &config = configExecution();
+    const char *variables[][2] = {{"TP_THREADS",  "--threads"},
+                                  {"TP_AFFINITE", "--affinite"},
+                                  {"TP_EPINGLER", "--epingler"},
+                                  {"TP_PERF",     "--perf"},
+                                  {"TP_NUMA",     "--numa"},
+                                  {"TP_BACKEND",  "--backend"}};
+    std::string erreur;
+    for (size_t v = 0; v < sizeof(variables) / sizeof(variables[0]) && erreur.empty(); v++) {
+        const char *valeur = getenv(variables[v][0]);
+        if (valeur != nullptr && !lireValeurConfig(variables[v][1], valeur, config)) {
+            erreur = std::string(variables[v][0]) + "=" + valeur;
+        }
+    }
+
+    int j = 1;
+    for (int i = 1; i < argc && erreur.empty(); i++) {
+        std::string option = argv[i];
+        if (option == "--epingler" || option == "--perf") {
+            lireValeurConfig(option, "1", config);
+        } else if (option == "--threads" || option == "--affinite" || option == "--numa" || option == "--backend") {
+            if (i + 1 >= argc || !lireValeurConfig(option, argv[i + 1], config)) {
+                erreur = option + (i + 1 < argc ? " " + std::string(argv[i + 1]) : "");
+            }
+            i++;
+        } else {
+            argv[j++] = argv[i];
+        }
+    }
+    if (erreur.empty()) {
+        argc = j;
+        argv[argc] = nullptr;
+    }
+
+    // les compteurs ne suivent que les threads créés après leur ouverture
+    if (erreur.empty() && config.perf) activerCompteursPerf();
+
+    if (!erreur.empty() || !appliquerConfigExecution(config, erreur)) {
+        std::cout << "Configuration d'exécution invalide : " << erreur << std::endl;
+        exit(1);
+    }
+}
+
+inline std::string decrireConfigExecution() {
+    const ConfigExecution &config = configExecution();
+    return std::to_string(cv::getNumThreads()) + " threads sur " + std::to_string(config.coeursAutorises.size())
+           + " cœurs" + (config.epingler ? " (épinglés)" : "")
+           + (config.noeudNuma >= 0 ? ", nœud NUMA " + std::to_string(config.noeudNuma) : "")
+           + ", backends conv=" + nomBackend(config.backendConvolution)
+           + " median=" + nomBackend(config.backendMedian);
+}
+
+/* avec --epingler : le thread d'indice donné ne tourne plus que sur un des cœurs autorisés */
+inline void epinglerThread(int indice) {
+    const ConfigExecution &config = configExecution();
+    if (!config.epingler || config.coeursAutorises.empty()) return;
+    cpu_set_t masque;
+    CPU_ZERO(&masque);
+    CPU_SET(config.coeursAutorises[indice % config.coeursAutorises.size()], &masque);
+    sched_setaffinity(0, sizeof(masque), &masque);
+}
+
+/* corps(b) pour chaque bande b : sur le pool d'OpenCV, ou dans le thread appelant avec le backend serie */
+template<typename Corps>
+inline void executerBandes(BackendNoyau backend, int nbBandes, const Corps &corps) {
+    if (backend == BACKEND_SERIE) {
+        for (int b = 0; b < nbBandes; b++) corps(b);
+        return;
+    }
+    cv::parallel_for_(cv::Range(0, nbBandes), [&](const cv::Range &plage) {
+        for (int b = plage.start; b < plage.end; b++) corps(b);
+    });
+}
+
+#endif //TP_CONFIG_EXECUTION_HPP
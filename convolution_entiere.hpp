@@ -0,0 +1,248 @@
+#ifndef TP_CONVOLUTION_ENTIERE_HPP
+#define TP_CONVOLUTION_ENTIERE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "opencv2/core/hal/intrin.hpp"
+#include "opencv2/imgproc.hpp"
+#include "compteurs_perf.hpp"
+#include "config_execution.hpp"
+
+/**
+ * Convolution entière pour les petits noyaux du TP2.
+ *
+ * Les noyaux de filtreM (binomial 1-2-1) et de Sobel sont séparables et à
+ * poids entiers une fois multipliés par un diviseur (16, 4...). Sur une image
+ * CV_8UC1 on les applique en deux passes 1D entières (horizontale puis
+ * verticale) avec un tampon circulant de 2r+1 lignes, ce qui évite le calcul
+ * flottant générique de filter2D. Les noyaux entiers non séparables (celui de
+ * rehaussementContraste) passent par une somme de décalages de lignes.
+ * Tout le reste retombe sur filter2D.
+ */
+
+/* noyau entier : K = noyau * diviseur */
+struct NoyauEntier {
+    int rayon = 0;
+    int diviseur = 1;
+    bool separable = false;
+    std::vector<int> kx;        // poids horizontaux (séparable)
+    std::vector<int> ky;        // poids verticaux (séparable)
+    std::vector<int> poids;     // (2r+1)x(2r+1) poids (non séparable)
+};
+
+inline int pgcd(int a, int b) {
+    a = std::abs(a);
+    b = std::abs(b);
+    while (b != 0) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/* détecte si le noyau flottant est (séparable ou non) à petits poids entiers */
+inline bool analyserNoyau(const cv::Mat &noyau, NoyauEntier &resultat) {
+    if (noyau.empty() || noyau.rows != noyau.cols || noyau.rows % 2 == 0 || noyau.rows > 15)
+        return false;
+
+    cv::Mat k;
+    noyau.convertTo(k, CV_64F);
+    int n = k.rows;
+
+    // plus petit diviseur puissance de 2 qui rend tous les poids entiers
+    int diviseur = 1;
+    std::vector<int> K(n * n);
+    bool entier = false;
+    for (; diviseur <= (1 << 16); diviseur *= 2) {
+        entier = true;
+        for (int i = 0; i < n && entier; i++) {
+            for (int j = 0; j < n; j++) {
+                double v = k.at<double>(i, j) * diviseur;
+                double r = std::floor(v + 0.5);
+                if (std::abs(v - r) > 1e-6 || std::abs(r) > (1 << 15)) {
+                    entier = false;
+                    break;
+                }
+                K[i * n + j] = (int) r;
+            }
+        }
+        if (entier) break;
+    }
+    if (!entier) return false;
+
+    resultat.rayon = n / 2;
+    resultat.diviseur = diviseur;
+
+    // séparabilité : K est de rang 1 si K[i][j] * K[p][q] == K[i][q] * K[p][j]
+    int p = -1, q = -1;
+    for (int i = 0; i < n * n && p < 0; i++) {
+        if (K[i] != 0) {
+            p = i / n;
+            q = i % n;
+        }
+    }
+    if (p < 0) return false;
+
+    bool rangUn = true;
+    for (int i = 0; i < n && rangUn; i++) {
+        for (int j = 0; j < n; j++) {
+            if ((long long) K[i * n + j] * K[p * n + q] != (long long) K[i * n + q] * K[p * n + j]) {
+                rangUn = false;
+                break;
+            }
+        }
+    }
+
+    long long sommeAbs = 0;
+    if (rangUn) {
+        // kx = ligne p divisée par son pgcd, ky[i] = K[i][q] / kx[q] (entier)
+        int g = 0;
+        for (int j = 0; j < n; j++) g = pgcd(g, K[p * n + j]);
+        resultat.kx.assign(n, 0);
+        resultat.ky.assign(n, 0);
+        for (int j = 0; j < n; j++) resultat.kx[j] = K[p * n + j] / g;
+        for (int i = 0; i < n; i++) resultat.ky[i] = K[i * n + q] / resultat.kx[q];
+
+        long long sx = 0, sy = 0;
+        for (int j = 0; j < n; j++) sx += std::abs(resultat.kx[j]);
+        for (int i = 0; i < n; i++) sy += std::abs(resultat.ky[i]);
+        sommeAbs = sx * sy;
+        resultat.separable = true;
+    } else {
+        for (int i = 0; i < n * n; i++) sommeAbs += std::abs(K[i]);
+        resultat.poids = K;
+        resultat.separable = false;
+    }
+
+    // l'accumulateur 32 bits doit contenir 255 * somme des |poids|
+    return sommeAbs * 255 < (1LL << 31);
+}
+
+/* acc[x] += poids * ligne[x] */
+inline void accumulerLigne(int *acc, const int *ligne, int poids, int n) {
+    if (poids == 0) return;
+    int x = 0;
+#if CV_SIMD128
+    cv::v_int32x4 vp = cv::v_setall_s32(poids);
+    for (; x <= n - 8; x += 8) {
+        cv::v_int32x4 a0 = cv::v_load(acc + x) + cv::v_load(ligne + x) * vp;
+        cv::v_int32x4 a1 = cv::v_load(acc + x + 4) + cv::v_load(ligne + x + 4) * vp;
+        cv::v_store(acc + x, a0);
+        cv::v_store(acc + x + 4, a1);
+    }
+#endif
+    for (; x < n; x++) acc[x] += poids * ligne[x];
+}
+
+/* dst[x] = saturate(round(acc[x] / diviseur + delta)) */
+inline void ecrireLigne(const int *acc, uchar *dst, int n, float echelle, float delta) {
+    int x = 0;
+#if CV_SIMD128
+    cv::v_float32x4 ve = cv::v_setall_f32(echelle);
+    cv::v_float32x4 vd = cv::v_setall_f32(delta);
+    for (; x <= n - 16; x += 16) {
+        cv::v_int32x4 r0 = cv::v_round(cv::v_cvt_f32(cv::v_load(acc + x)) * ve + vd);
+        cv::v_int32x4 r1 = cv::v_round(cv::v_cvt_f32(cv::v_load(acc + x + 4)) * ve + vd);
+        cv::v_int32x4 r2 = cv::v_round(cv::v_cvt_f32(cv::v_load(acc + x + 8)) * ve + vd);
+        cv::v_int32x4 r3 = cv::v_round(cv::v_cvt_f32(cv::v_load(acc + x + 12)) * ve + vd);
+        cv::v_store(dst + x, cv::v_pack_u(cv::v_pack(r0, r1), cv::v_pack(r2, r3)));
+    }
+#endif
+    for (; x < n; x++) dst[x] = cv::saturate_cast<uchar>(cvRound(acc[x] * echelle + delta));
+}
+
+/* copie la ligne src (largeur n) élargie en int avec r pixels de bord réfléchis de chaque côté */
+inline void elargirLigne(const uchar *src, int *dst, int n, int r) {
+    for (int x = -r; x < n + r; x++) {
+        dst[x + r] = src[cv::borderInterpolate(x, n, cv::BORDER_REFLECT_101)];
+    }
+}
+
+/* applique le noyau entier sur les lignes [debut, fin) de src */
+inline void convolutionBande(const cv::Mat &src, cv::Mat &dst, const NoyauEntier &noyau, float delta,
+                             int debut, int fin) {
+    const int r = noyau.rayon;
+    const int n = 2 * r + 1;
+    const int largeur = src.cols;
+    const int largeurBord = largeur + 2 * r;
+    const float echelle = 1.0f / noyau.diviseur;
+
+    // tampon circulant de n lignes : résultat de la passe horizontale (séparable)
+    // ou ligne source élargie (non séparable)
+    const int largeurAnneau = noyau.separable ? largeur : largeurBord;
+    std::vector<int> anneau(n * largeurAnneau);
+    std::vector<int> elargie(largeurBord);
+    std::vector<int> acc(largeur);
+
+    // remplit l'emplacement de la ligne virtuelle k (avant réflexion)
+    auto chargerLigne = [&](int k) {
+        int ys = cv::borderInterpolate(k, src.rows, cv::BORDER_REFLECT_101);
+        int *emplacement = &anneau[((k + r) % n) * largeurAnneau];
+        if (noyau.separable) {
+            elargirLigne(src.ptr<uchar>(ys), elargie.data(), largeur, r);
+            std::fill(emplacement, emplacement + largeur, 0);
+            for (int j = 0; j < n; j++) {
+                accumulerLigne(emplacement, elargie.data() + j, noyau.kx[j], largeur);
+            }
+        } else {
+            elargirLigne(src.ptr<uchar>(ys), emplacement, largeur, r);
+        }
+    };
+
+    for (int k = debut - r; k < debut + r; k++) chargerLigne(k);
+
+    for (int y = debut; y < fin; y++) {
+        chargerLigne(y + r);
+        std::fill(acc.begin(), acc.end(), 0);
+
+        for (int i = 0; i < n; i++) {
+            const int *ligne = &anneau[((y + i) % n) * largeurAnneau];
+            if (noyau.separable) {
+                accumulerLigne(acc.data(), ligne, noyau.ky[i], largeur);
+            } else {
+                for (int j = 0; j < n; j++) {
+                    accumulerLigne(acc.data(), ligne + j, noyau.poids[i * n + j], largeur);
+                }
+            }
+        }
+
+        ecrireLigne(acc.data(), dst.ptr<uchar>(y), largeur, echelle, delta);
+    }
+}
+
+/**
+ * Equivalent de filter2D(input, output, -1, noyau, Point(-1, -1), delta)
+ * (bord BORDER_REFLECT_101). Utilise la convolution entière quand l'image est
+ * CV_8UC1 et le noyau à petits poids entiers, filter2D sinon (ou toujours avec
+ * le backend reference, config_execution.hpp).
+ */
+inline void convolutionRapide(const cv::Mat &input, cv::Mat &output, const cv::Mat &noyau, double delta = 0.0) {
+    MesurePerf mesure("convolutionRapide", (double) input.total());
+    const BackendNoyau backend = configExecution().backendConvolution;
+    NoyauEntier noyauEntier;
+    if (backend == BACKEND_REFERENCE || input.type() != CV_8UC1 || input.rows <= noyau.rows || input.cols <= noyau.cols
+        || !analyserNoyau(noyau, noyauEntier)) {
+        cv::filter2D(input, output, -1, noyau, cv::Point(-1, -1), delta);
+        return;
+    }
+
+    // la sortie ne doit pas recouvrir l'entrée : les lignes voisines sont encore lues
+    cv::Mat src = input;
+    if (output.data == input.data) src = input.clone();
+    output.create(src.size(), CV_8UC1);
+
+    // bandes horizontales en parallèle, chacune avec son propre tampon circulant
+    const int hauteurBande = 64;
+    const int nbBandes = (src.rows + hauteurBande - 1) / hauteurBande;
+    executerBandes(backend, nbBandes, [&](int b) {
+        int debut = b * hauteurBande;
+        int fin = std::min(src.rows, debut + hauteurBande);
+        convolutionBande(src, output, noyauEntier, (float) delta, debut, fin);
+    });
+}
+
+#endif //TP_CONVOLUTION_ENTIERE_HPP
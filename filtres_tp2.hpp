@@ -0,0 +1,262 @@
+#ifndef TP_FILTRES_TP2_HPP
+#define TP_FILTRES_TP2_HPP
+
+#include <cmath>
+#include <cstdlib>
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+#include "compteurs_perf.hpp"
+#include "convolution_entiere.hpp"
+#include "median_constant.hpp"
+#include "pipeline.hpp"
+
+/**
+ * Filtres du TP2 et leur catalogue d'étapes, partagés par main_tp2 et le
+ * serveur de traitements (serveur_tp).
+ */
+
+/** --- FILTRE MOYENNEUR --- **/
+inline cv::Mat noyauMoyenneur() {
+    return (cv::Mat_<float>(3, 3) <<
+                                  1.0 / 16, 2.0 / 16, 1.0 / 16,
+            2.0 / 16, 4.0 / 16, 2.0 / 16,
+            1.0 / 16, 2.0 / 16, 1.0 / 16);
+}
+
+inline cv::Mat filtreM(cv::Mat input) {
+    cv::Mat output;
+
+    // Appliquer le filtrage (noyau séparable 1-2-1 : passes entières si l'image est en 8 bits)
+    convolutionRapide(input, output, noyauMoyenneur());
+
+    return output;
+}
+
+/** --- MEDIANE --- **/
+inline cv::Mat medianBlur(cv::Mat input, int rayon = 1) {
+    cv::Mat output;
+    if (rayon <= 1) {
+        cv::medianBlur(input, output, 3);
+    } else {
+        // histogrammes de colonnes : coût par pixel indépendant du rayon
+        medianConstant(input, output, rayon);
+    }
+    return output;
+}
+
+/** --- REHAUSSEMENT DE CONTRASTE --- **/
+inline cv::Mat noyauRehaussement(int alpha) {
+    cv::Mat matrice = (cv::Mat_<float>(3, 3) << 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0);
+    cv::Mat laplacien = (cv::Mat_<float>(3, 3) << 0.0, 1.0, 0.0, 1.0, -4.0, 1.0, 0.0, 1.0, 0.0);
+    return matrice - alpha * laplacien;
+}
+
+inline cv::Mat rehaussementContraste(cv::Mat input, int alpha) {
+    cv::Mat output;
+    convolutionRapide(input, output, noyauRehaussement(alpha));
+    return output;
+}
+
+/** --- FILTRES DERIVATIFS --- **/
+inline cv::Mat noyauSobelX() {
+    return (cv::Mat_<float>(3, 3) <<
+                                  -1.0 / 4.0, 0.0, 1.0 / 4.0,
+            -2.0 / 4.0, 0.0, 2.0 / 4.0,
+            -1.0 / 4.0, 0.0, 1.0 / 4.0);
+}
+
+inline cv::Mat noyauSobelY() {
+    return (cv::Mat_<float>(3, 3) <<
+                                  -1.0 / 4.0, -2.0 / 4.0, -1.0 / 4.0,
+            0.0, 0.0, 0.0,
+            1.0 / 4.0, 2.0 / 4.0, 1.0 / 4.0);
+}
+
+inline cv::Mat sobelX(cv::Mat input, float delta = 128.0) {
+    cv::Mat output;
+    convolutionRapide(input, output, noyauSobelX(), delta);
+    return output;
+}
+
+inline cv::Mat sobelY(cv::Mat input, float delta = 128.0) {
+    cv::Mat output;
+    convolutionRapide(input, output, noyauSobelY(), delta);
+    return output;
+}
+
+/** --- GRADIENT --- **/
+inline cv::Mat gradientFromSobel(cv::Mat input) {
+    MesurePerf mesure("gradientFromSobel", (double) input.total());
+    cv::Mat output;
+    cv::Mat imageSobelX;
+    cv::Mat imageSobelY;
+
+    input.convertTo(input, CV_32FC1);
+
+    input.copyTo(output);
+    input.copyTo(imageSobelX);
+    input.copyTo(imageSobelY);
+
+    imageSobelX = sobelX(imageSobelX, 0.0);
+    imageSobelY = sobelY(imageSobelY, 0.0);
+
+    int nbCols = input.cols;
+    int nbRows = input.rows;
+
+    for (int y = 0; y < nbCols; y++) {
+        for (int x = 1; x < nbRows; x++) {
+            output.at<float>(x, y) = sqrt(
+                    (imageSobelX.at<float>(x, y) * imageSobelX.at<float>(x, y))
+                    + (imageSobelY.at<float>(x, y) * imageSobelY.at<float>(x, y)));
+        }
+    }
+
+    input.convertTo(input, CV_8UC1);
+    output.convertTo(output, CV_8UC1);
+
+    return output;
+}
+
+/** --- DETECTION MARR-HILDRETH --- **/
+inline bool isChangedInNeighborhood(cv::Mat input, cv::Mat laplacien, int x, int y) {
+    for (int k = x - 1; k < x + 2; k++) {
+        for (int n = y - 1; n < y + 2; n++) {
+            if ((input.at<float>(k, n) < 0 && laplacien.at<float>(k, n) >= 0)
+                || (input.at<float>(k, n) >= 0 && laplacien.at<float>(k, n) < 0)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+inline cv::Mat seuilMarrHildreth(cv::Mat input, int seuil, int alpha) {
+    cv::Mat output;
+    cv::Mat imageGradient;
+    cv::Mat imageLaplacien;
+
+    input.convertTo(input, CV_32FC1);
+
+    input.copyTo(output);
+    input.copyTo(imageGradient);
+    input.copyTo(imageLaplacien);
+
+    imageLaplacien = rehaussementContraste(input, alpha);
+
+    imageGradient = gradientFromSobel(imageGradient);
+    imageGradient.convertTo(imageGradient, CV_32FC1);
+
+    for (int y = 0; y < input.cols - 1; y++) {
+        for (int x = 1; x < input.rows - 1; x++) {
+            bool isChanged = isChangedInNeighborhood(input, imageLaplacien, x, y);
+            if (imageGradient.at<float>(x, y) >= (float) seuil && isChanged) {
+                output.at<float>(x, y) = 0.0;
+            } else {
+                output.at<float>(x, y) = 255.0;
+            }
+        }
+    }
+
+    input.convertTo(input, CV_8UC1);
+    output.convertTo(output, CV_8UC1);
+
+    return output;
+}
+
+/** --- ESQUISSE --- **/
+inline double rand01() {
+    return rand() / (double) RAND_MAX;
+}
+
+inline cv::Mat esquisse(cv::Mat input, int seuil, int alpha, int proportion, int longueur) {
+    cv::Mat output;
+    cv::Mat imageGradient;
+    cv::Mat imageLaplacien;
+
+    input.convertTo(input, CV_32FC1);
+
+    input.copyTo(output);
+    input.copyTo(imageGradient);
+    input.copyTo(imageLaplacien);
+
+    imageLaplacien = rehaussementContraste(input, alpha);
+
+    imageGradient = gradientFromSobel(imageGradient);
+    imageGradient.convertTo(imageGradient, CV_32FC1);
+
+    for (int y = 0; y < input.cols; y++) {
+        for (int x = 1; x < input.rows; x++) {
+            bool isChanged = isChangedInNeighborhood(input, imageLaplacien, x, y);
+            if (imageGradient.at<float>(x, y) >= (float) seuil && isChanged) {
+                if (rand01() < (proportion / 100.0)) {
+                    double theta = atan2(-y, x) + M_PI / 2 + 0.02 * (rand01() - 0.5);
+                    float g = imageGradient.at<float>(x, y);
+                    double longueurP = (g / 255.0) * (longueur / 100.0);
+                    cv::line(output,
+                             cv::Point_<float>(y + longueurP * cos(theta), x + longueurP * sin(theta)),
+                             cv::Point_<float>(y - longueurP * cos(theta), x - longueurP * sin(theta)),
+                             0, 1, 1);
+                } else {
+                    output.at<float>(x, y) = 255.0;
+                }
+            } else {
+                output.at<float>(x, y) = 255.0;
+            }
+        }
+    }
+
+    input.convertTo(input, CV_8UC1);
+    output.convertTo(output, CV_8UC1);
+
+    return output;
+}
+
+/** --- CHAINE DE FILTRES --- **/
+/* étapes utilisables dans une chaîne ("a,s,g,t"), avec les valeurs courantes des trackbars */
+inline CatalogueEtapes catalogueTP2(int alpha, int seuil, int rayon, int proportion, int longueur) {
+    CatalogueEtapes catalogue;
+
+    catalogue["a"] = etapeVoisinage("a", 1, [](const cv::Mat &in, cv::Mat &out) {
+        convolutionRapide(in, out, noyauMoyenneur());
+    });
+    catalogue["m"] = etapeVoisinage("m", std::max(rayon, 1), [rayon](const cv::Mat &in, cv::Mat &out) {
+        if (rayon <= 1) {
+            cv::medianBlur(in, out, 3);
+        } else {
+            medianConstant(in, out, rayon);
+        }
+    });
+    catalogue["s"] = etapeVoisinage("s", 1, [alpha](const cv::Mat &in, cv::Mat &out) {
+        convolutionRapide(in, out, noyauRehaussement(alpha));
+    });
+    catalogue["x"] = etapeVoisinage("x", 1, [](const cv::Mat &in, cv::Mat &out) {
+        convolutionRapide(in, out, noyauSobelX(), 128.0);
+    });
+    catalogue["y"] = etapeVoisinage("y", 1, [](const cv::Mat &in, cv::Mat &out) {
+        convolutionRapide(in, out, noyauSobelY(), 128.0);
+    });
+    catalogue["g"] = etapeVoisinage("g", 1, [](const cv::Mat &in, cv::Mat &out) {
+        out = gradientFromSobel(in);
+    });
+    // Laplacien (rayon 1) puis test du voisinage (rayon 1)
+    catalogue["t"] = etapeVoisinage("t", 2, [seuil, alpha](const cv::Mat &in, cv::Mat &out) {
+        out = seuilMarrHildreth(in, seuil, alpha);
+    });
+    catalogue["e"] = etapeGlobale("e", [seuil, alpha, proportion, longueur](const cv::Mat &in, cv::Mat &out) {
+        out = esquisse(in, seuil, alpha, proportion, longueur);
+    });
+
+    // Etapes ponctuelles : fusionnées en une seule table
+    cv::Mat negatif(1, 256, CV_8UC1);
+    cv::Mat binarisation(1, 256, CV_8UC1);
+    for (int i = 0; i < 256; i++) {
+        negatif.at<uchar>(i) = (uchar) (255 - i);
+        binarisation.at<uchar>(i) = (i > seuil) ? 255 : 0;
+    }
+    catalogue["n"] = etapePonctuelle("n", negatif);
+    catalogue["b"] = etapePonctuelle("b", binarisation);
+
+    return catalogue;
+}
+
+#endif //TP_FILTRES_TP2_HPP
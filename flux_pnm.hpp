@@ -0,0 +1,142 @@
+#ifndef TP_FLUX_PNM_HPP
+#define TP_FLUX_PNM_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+
+/**
+ * Lecture et écriture d'images PGM / PPM binaires (P5 / P6, 8 bits) par
+ * bandes de lignes, sans jamais charger l'image entière. Les images PPM sont
+ * converties en niveaux de gris à la lecture.
+ */
+
+class LecteurPNM {
+public:
+    ~LecteurPNM() {
+        if (fichier != nullptr) fclose(fichier);
+    }
+
+    bool ouvrir(const std::string &chemin) {
+        fichier = fopen(chemin.c_str(), "rb");
+        if (fichier == nullptr) return false;
+
+        char magique[3] = {0, 0, 0};
+        if (fread(magique, 1, 2, fichier) != 2 || magique[0] != 'P' || (magique[1] != '5' && magique[1] != '6')) {
+            std::cout << chemin << " : seuls les PGM (P5) et PPM (P6) binaires sont lus par bandes" << std::endl;
+            return false;
+        }
+        canaux = (magique[1] == '6') ? 3 : 1;
+
+        int maxval = 0;
+        if (!lireEntier(largeur) || !lireEntier(hauteur) || !lireEntier(maxval) || maxval > 255 || largeur <= 0
+            || hauteur <= 0) {
+            std::cout << chemin << " : en-tête invalide ou image 16 bits" << std::endl;
+            return false;
+        }
+        fgetc(fichier);     // un seul blanc entre l'en-tête et les pixels
+        debutPixels = ftell(fichier);
+        ligneCourante = 0;
+        return true;
+    }
+
+    /* lit jusqu'à n lignes suivantes (CV_8UC1), faux à la fin de l'image ou si le fichier est tronqué (complet) */
+    bool lire(int n, cv::Mat &bande) {
+        n = std::min(n, hauteur - ligneCourante);
+        if (n <= 0) return false;
+
+        brut.create(n, largeur, CV_8UC(canaux));
+        if (fread(brut.data, (size_t) largeur * canaux, n, fichier) != (size_t) n) return false;
+        if (canaux == 3) {
+            cv::cvtColor(brut, bande, cv::COLOR_RGB2GRAY);
+        } else {
+            brut.copyTo(bande);
+        }
+        ligneCourante += n;
+        return true;
+    }
+
+    /* vrai quand toutes les lignes annoncées par l'en-tête ont été lues */
+    bool complet() const {
+        return ligneCourante == hauteur;
+    }
+
+    void rembobiner() {
+        fseek(fichier, debutPixels, SEEK_SET);
+        ligneCourante = 0;
+    }
+
+    int largeur = 0;
+    int hauteur = 0;
+
+private:
+    FILE *fichier = nullptr;
+    int canaux = 1;
+    long debutPixels = 0;
+    int ligneCourante = 0;
+    cv::Mat brut;
+
+    /* entier ASCII de l'en-tête, commentaires '#' ignorés */
+    bool lireEntier(int &valeur) {
+        int c = fgetc(fichier);
+        while (c != EOF && (isspace(c) || c == '#')) {
+            if (c == '#') {
+                while (c != EOF && c != '\n') c = fgetc(fichier);
+            }
+            c = fgetc(fichier);
+        }
+        if (c == EOF || !isdigit(c)) return false;
+        valeur = 0;
+        while (c != EOF && isdigit(c)) {
+            valeur = valeur * 10 + (c - '0');
+            c = fgetc(fichier);
+        }
+        ungetc(c, fichier);
+        return true;
+    }
+};
+
+class EcrivainPGM {
+public:
+    ~EcrivainPGM() {
+        if (fichier != nullptr) fclose(fichier);
+    }
+
+    bool ouvrir(const std::string &chemin, int largeur, int hauteur) {
+        fichier = fopen(chemin.c_str(), "wb");
+        if (fichier == nullptr) return false;
+        ok = fprintf(fichier, "P5\n%d %d\n255\n", largeur, hauteur) > 0;
+        return ok;
+    }
+
+    /* écrit les lignes suivantes (CV_8UC1) ; faux dès qu'une écriture a échoué (disque plein...) */
+    bool ecrire(const cv::Mat &bande) {
+        for (int i = 0; ok && i < bande.rows; i++) {
+            ok = fwrite(bande.ptr<uchar>(i), 1, bande.cols, fichier) == (size_t) bande.cols;
+        }
+        return ok;
+    }
+
+    /* vrai tant qu'aucune écriture n'a échoué */
+    bool valide() const {
+        return ok;
+    }
+
+    /* ferme le fichier ; faux si une écriture ou la fermeture (tampon vidé) a échoué : la sortie est incomplète */
+    bool fermer() {
+        if (fichier == nullptr) return ok;
+        ok = (fclose(fichier) == 0) && ok;
+        fichier = nullptr;
+        return ok;
+    }
+
+private:
+    FILE *fichier = nullptr;
+    bool ok = false;
+};
+
+#endif //TP_FLUX_PNM_HPP
@@ -1,114 +1,31 @@
 #include <iostream>
 #include "opencv2/highgui.hpp"
 #include "opencv2/imgproc.hpp"
+#include "cache_images.hpp"
+#include "config_execution.hpp"
+#include "pipeline_flux.hpp"
+#include "traitements_gris.hpp"
 
 using namespace cv;
 
-/** HISTOGRAMME **/
-std::vector<double> histogramme(Mat image) {
-    std::vector<double> histogramme(256, 0.0);
-
-    for (int i = 0; i < image.rows; i++) {
-        for (int j = 0; j < image.cols; j++) {
-            int greyLevel = (int) image.at<uchar>(i, j);
-            histogramme[greyLevel]++;
-        }
-    }
-
-    for (int i = 0; i < histogramme.size(); i++) {
-        histogramme[i] = histogramme[i] / (image.rows * image.cols);
-    }
-
-    return histogramme;
-}
-
-/** HISTOGRAMME CUMULE **/
-std::vector<double> histogramme_cumule(const std::vector<double> &h_I) {
-    std::vector<double> histogrammeCumule(256, 0.0);
-
-    for (int i = 0; i < h_I.size(); i++) {
-        if (i == 0) {
-            histogrammeCumule[i] = h_I[i];
-        } else {
-            histogrammeCumule[i] = h_I[i] + histogrammeCumule[i - 1];
-        }
-    }
-
-    return histogrammeCumule;
-}
-
-/** AFFICHAGE DES DEUX HISTOGRAMMES **/
-Mat afficheHistogrammes(const std::vector<double> &h_I,
-                            const std::vector<double> &H_I) {
-    Mat image(256, 512, CV_8UC1, 255.0);
-
-    // Affichage de l'histogramme
-    auto maxValue_h_I = std::max_element(h_I.begin(), h_I.end());
-
-    for (int i = 0; i < h_I.size(); i++) {
-        auto newValue = (((h_I[i]) * image.rows) / *maxValue_h_I);
-        for (int j = 0; j < newValue; j++) {
-            image.at<uchar>(image.rows - 1 - j, i) = 0;
-        }
-    }
-
-    // Affichage de l'histogramme cumulé
-    auto maxValue_H_I = std::max_element(H_I.begin(), H_I.end());
-
-    for (int i = 0; i < H_I.size(); i++) {
-        auto newValue = (((H_I[i]) * image.rows) / *maxValue_H_I);
-        for (int j = 0; j < newValue; j++) {
-            image.at<uchar>(image.rows - 1 - j, h_I.size() + i) = 0;
-        }
-    }
-
-    return image;
-}
-
-/** EGALISATION **/
-Mat equalization(Mat image,
-                     std::vector<double> &h_I,
-                     std::vector<double> &H_I) {
-    // Parcours tout les pixels de l'image
-    for (int i = 0; i < image.rows; i++) {
-        for (int j = 0; j < image.cols; j++) {
-            int greyLevel = (int) image.at<uchar>(i, j);
-            image.at<uchar>(i, j) = 255.0 * (double) H_I[greyLevel];
-        }
-    }
-    h_I = histogramme(image);
-    H_I = histogramme_cumule(h_I);
-    return image;
-}
-
-/** TRAMAGE FLOYD STEINBERG **/
-void tramage_floyd_steinberg(Mat input, Mat output) {
-    input.convertTo(input, CV_32FC1);
-    input.copyTo(output);
-
-    // pour chaque x de gauche à droite
-    for (int y = 0; y < output.cols - 1; y++) {
-        // pour chaque y de haut en bas
-        for (int x = 1; x < output.rows - 1; x++) {
-            float ancien_pixel = output.at<float>(x, y);
-            float nouveau_pixel = (ancien_pixel > 128.0) ? 255.0 : 0.0;
-            output.at<float>(x, y) = nouveau_pixel;
-            float erreur_quantification = ancien_pixel - nouveau_pixel;
-            output.at<float>(x + 1, y) = output.at<float>(x + 1, y) + (7.0 / 16.0 * erreur_quantification);
-            output.at<float>(x - 1, y + 1) = output.at<float>(x - 1, y + 1) + (3.0 / 16.0 * erreur_quantification);
-            output.at<float>(x, y + 1) = output.at<float>(x, y + 1) + (5.0 / 16.0 * erreur_quantification);
-            output.at<float>(x + 1, y + 1) = output.at<float>(x + 1, y + 1) + (1.0 / 16.0 * erreur_quantification);
+/** MAIN **/
+int main(int argc, char *argv[]) {
+    // threads, affinité et backends (options retirées de argv, config_execution.hpp)
+    configurerExecution(argc, argv);
+
+    // Mode tuiles : l'image est lue, traitée et écrite par bandes
+    if (argv[1] != nullptr && String(argv[1]) == "--tuiles") {
+        if (argc < 5) {
+            std::cout << "\nUsage : ./main_grey_img --tuiles <entree.pgm> <sortie.pgm> <chaine> [hauteurBande]\n"
+                      << std::endl;
+            exit(1);
         }
+        int hauteurBande = (argc > 5) ? atoi(argv[5]) : 256;
+        return executerTuiles(argv[2], argv[3], argv[4], catalogueGris(128), hauteurBande) ? 0 : 1;
     }
 
-    input.convertTo(input, CV_8UC1);
-    output.convertTo(output, CV_8UC1);
-}
-
-/** MAIN **/
-int main(int, char *argv[]) {
     if (argv[1] == nullptr || argv[2] == nullptr) {
-        std::cout << "\nUsage : ./main_grey_img <nom-fichier-image> <egal | tram | none>\n" << std::endl;
+        std::cout << "\nUsage : ./main_grey_img <nom-fichier-image> <egal | tram | none | chaine, ex. egal,tram> [sortie.pbm | sortie.png]\n" << std::endl;
         exit(1);
     }
 
@@ -121,7 +38,8 @@ int main(int, char *argv[]) {
     namedWindow("TP1 Grey IMG");               // crée une fenêtre
     createTrackbar("track grey", "TP1 Grey IMG", &value, 255, nullptr); // un slider
 
-    Mat f = imread(path + filename);        // lit l'image  donné en argument
+    Mat f = chargerImage(path + filename);  // lit l'image  donné en argument (décodée une seule fois, cache_images.hpp)
+    afficherStatistiquesCache();
 
     /** --- DEBUT DES APPELS DE FONCTIONS --- **/
     // Converti l'image en noir et blanc
@@ -133,27 +51,56 @@ int main(int, char *argv[]) {
 
     if (functionToExecute == "egal") {
         // Histogrammes
-        std::vector<double> hist = histogramme(f);
-        std::vector<double> histCumule = histogramme_cumule(hist);
+        std::vector<double> hist, histCumule;
+        histogramme<uchar>(f, hist);
+        histogramme_cumule(hist, histCumule);
 
-        // Egalisation
-        Mat equalizedImg = equalization(f, hist, histCumule);
+        // Egalisation, puis histogrammes de l'image égalisée
+        Mat equalizedImg;
+        equalization<uchar>(f, histCumule, equalizedImg);
+        histogramme<uchar>(equalizedImg, hist);
+        histogramme_cumule(hist, histCumule);
 
         // Affichage des histogrammes
-        Mat displayHistogrammes = afficheHistogrammes(hist, histCumule);
+        Mat displayHistogrammes;
+        afficheHistogrammes(hist, histCumule, displayHistogrammes);
         namedWindow("Histogrammes Grey IMG");
         imshow("Histogrammes Grey IMG", displayHistogrammes);                // l'affiche dans la fenêtre
 
         imshow("TP1 Grey IMG", equalizedImg);
     } else if (functionToExecute == "tram") {
-        // Tramage Floyd Steinberg
-        Mat tramedImg(f.rows, f.cols, CV_32FC1, 0.0);
-        tramage_floyd_steinberg(f, tramedImg);
-        imshow("TP1 Grey IMG", tramedImg);
+        if (argv[3] != nullptr) {
+            // Tramage Floyd Steinberg sur 1 bit, écrit en PBM ou PNG 1 bit
+            Mat fs;
+            ImageIndexee tramedBits;
+            tramage_floyd_steinberg_indexe<uchar>(f, fs, tramedBits);
+            if (!ecrireImageIndexee(argv[3], tramedBits)) {
+                std::cout << "Impossible d'écrire " << argv[3] << std::endl;
+            }
+
+            Mat tramedImg;
+            decompacter(tramedBits, tramedImg);
+            imshow("TP1 Grey IMG", tramedImg);
+        } else {
+            // Tramage Floyd Steinberg
+            Mat fs, tramedImg;
+            tramage_floyd_steinberg<uchar>(f, fs, tramedImg);
+            imshow("TP1 Grey IMG", tramedImg);
+        }
     } else if (functionToExecute == "none") {
         imshow("TP1 Grey IMG", f);
+    } else if (functionToExecute.find(',') != String::npos) {
+        // Chaîne de traitements (ex. egal,tram) : tables fusionnées, tampons réutilisés
+        std::vector<Etape> etapes;
+        if (!analyserPipeline(functionToExecute, catalogueGris(value), etapes)) {
+            exit(1);
+        }
+        MoteurPipeline moteur;
+        Mat result;
+        moteur.executer(etapes, f, result);
+        imshow("TP1 Grey IMG", result);
     } else {
-        std::cout << "\nUsage : ./main_grey_img <nom-fichier-image> <egal | tram | none>\n" << std::endl;
+        std::cout << "\nUsage : ./main_grey_img <nom-fichier-image> <egal | tram | none | chaine, ex. egal,tram> [sortie.pbm | sortie.png]\n" << std::endl;
         exit(1);
     }
 
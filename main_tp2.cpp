@@ -1,206 +1,42 @@
 #include <iostream>
 #include "opencv2/imgproc.hpp"
 #include <opencv2/highgui.hpp>
+#include "cache_images.hpp"
+#include "config_execution.hpp"
+#include "filtres_tp2.hpp"
+#include "pipeline_flux.hpp"
 
 using namespace cv;
 
-/** --- FILTRE MOYENNEUR --- **/
-Mat filtreM(Mat input) {
-    Mat output;
-    Mat kernel = (Mat_<float>(3, 3) <<
-                                    1.0 / 16, 2.0 / 16, 1.0 / 16,
-            2.0 / 16, 4.0 / 16, 2.0 / 16,
-            1.0 / 16, 2.0 / 16, 1.0 / 16);
-
-    // Appliquer le filtrage
-    filter2D(input, output, -1, kernel);
-
-    return output;
-}
-
-/** --- MEDIANE --- **/
-Mat medianBlur(Mat input) {
-    Mat output;
-    medianBlur(input, output, 3);
-    return output;
-}
-
-/** --- REHAUSSEMENT DE CONTRASTE --- **/
-Mat rehaussementContraste(Mat input, int alpha) {
-    Mat output;
-
-    Mat matrice = (Mat_<float>(3, 3) << 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0);
-    Mat laplacien = (Mat_<float>(3, 3) << 0.0, 1.0, 0.0, 1.0, -4.0, 1.0, 0.0, 1.0, 0.0);
-    Mat result = matrice - alpha * laplacien;
-
-    filter2D(input, output, -1, result);
-    return output;
-}
-
-/** --- FILTRES DERIVATIFS --- **/
-Mat sobelX(Mat input, float delta = 128.0) {
-    Mat output;
-
-    Mat kernel = (Mat_<float>(3, 3) <<
-                                    -1.0 / 4.0, 0.0, 1.0 / 4.0,
-            -2.0 / 4.0, 0.0, 2.0 / 4.0,
-            -1.0 / 4.0, 0.0, 1.0 / 4.0);
-
-    filter2D(input, output, -1, kernel, Point(-1, -1), delta);
-    return output;
-}
-
-Mat sobelY(Mat input, float delta = 128.0) {
-    Mat output;
-
-    Mat kernel = (Mat_<float>(3, 3) <<
-                                    -1.0 / 4.0, -2.0 / 4.0, -1.0 / 4.0,
-            0.0, 0.0, 0.0,
-            1.0 / 4.0, 2.0 / 4.0, 1.0 / 4.0);
-
-    filter2D(input, output, -1, kernel, Point(-1, -1), delta);
-    return output;
-}
-
-/** --- GRADIENT --- **/
-Mat gradientFromSobel(Mat input) {
-    Mat output;
-    Mat imageSobelX;
-    Mat imageSobelY;
-
-    input.convertTo(input, CV_32FC1);
-
-    input.copyTo(output);
-    input.copyTo(imageSobelX);
-    input.copyTo(imageSobelY);
-
-    imageSobelX = sobelX(imageSobelX, 0.0);
-    imageSobelY = sobelY(imageSobelY, 0.0);
-
-    int nbCols = input.cols;
-    int nbRows = input.rows;
-
-    for (int y = 0; y < nbCols; y++) {
-        for (int x = 1; x < nbRows; x++) {
-            output.at<float>(x, y) = sqrt(
-                    (imageSobelX.at<float>(x, y) * imageSobelX.at<float>(x, y))
-                    + (imageSobelY.at<float>(x, y) * imageSobelY.at<float>(x, y)));
-        }
-    }
-
-    input.convertTo(input, CV_8UC1);
-    output.convertTo(output, CV_8UC1);
-
-    return output;
-}
-
-/** --- DETECTION MARR-HILDRETH --- **/
-bool isChangedInNeighborhood(Mat input, Mat laplacien, int x, int y) {
-    for (int k = x - 1; k < x + 2; k++) {
-        for (int n = y - 1; n < y + 2; n++) {
-            if ((input.at<float>(k, n) < 0 && laplacien.at<float>(k, n) >= 0)
-                || (input.at<float>(k, n) >= 0 && laplacien.at<float>(k, n) < 0)) {
-                return true;
-            }
-        }
-    }
-    return false;
-}
-
-Mat seuilMarrHildreth(Mat input, int seuil, int alpha) {
-    Mat output;
-    Mat imageGradient;
-    Mat imageLaplacien;
-
-    input.convertTo(input, CV_32FC1);
-
-    input.copyTo(output);
-    input.copyTo(imageGradient);
-    input.copyTo(imageLaplacien);
-
-    imageLaplacien = rehaussementContraste(input, alpha);
-
-    imageGradient = gradientFromSobel(imageGradient);
-    imageGradient.convertTo(imageGradient, CV_32FC1);
-
-    for (int y = 0; y < input.cols - 1; y++) {
-        for (int x = 1; x < input.rows - 1; x++) {
-            bool isChanged = isChangedInNeighborhood(input, imageLaplacien, x, y);
-            if (imageGradient.at<float>(x, y) >= (float) seuil && isChanged) {
-                output.at<float>(x, y) = 0.0;
-            } else {
-                output.at<float>(x, y) = 255.0;
-            }
-        }
-    }
-
-    input.convertTo(input, CV_8UC1);
-    output.convertTo(output, CV_8UC1);
-
-    return output;
-}
-
-/** --- ESQUISSE --- **/
-double rand01() {
-    return rand() / (double) RAND_MAX;
-}
-
-Mat esquisse(Mat input, int seuil, int alpha, int proportion, int longueur) {
-    Mat output;
-    Mat imageGradient;
-    Mat imageLaplacien;
-
-    input.convertTo(input, CV_32FC1);
-
-    input.copyTo(output);
-    input.copyTo(imageGradient);
-    input.copyTo(imageLaplacien);
-
-    imageLaplacien = rehaussementContraste(input, alpha);
-
-    imageGradient = gradientFromSobel(imageGradient);
-    imageGradient.convertTo(imageGradient, CV_32FC1);
-
-    for (int y = 0; y < input.cols; y++) {
-        for (int x = 1; x < input.rows; x++) {
-            bool isChanged = isChangedInNeighborhood(input, imageLaplacien, x, y);
-            if (imageGradient.at<float>(x, y) >= (float) seuil && isChanged) {
-                if (rand01() < (proportion / 100.0)) {
-                    double theta = atan2(-y, x) + M_PI / 2 + 0.02 * (rand01() - 0.5);
-                    float g = imageGradient.at<float>(x, y);
-                    double longueurP = (g / 255.0) * (longueur / 100.0);
-                    line(output,
-                         Point_<float>(y + longueurP * cos(theta), x + longueurP * sin(theta)),
-                         Point_<float>(y - longueurP * cos(theta), x - longueurP * sin(theta)),
-                         0, 1, 1);
-                } else {
-                    output.at<float>(x, y) = 255.0;
-                }
-            } else {
-                output.at<float>(x, y) = 255.0;
-            }
-        }
-    }
-
-    input.convertTo(input, CV_8UC1);
-    output.convertTo(output, CV_8UC1);
-
-    return output;
-}
-
 /** --- MAIN --- **/
-int main(int, char *argv[]) {
+int main(int argc, char *argv[]) {
+    // threads, affinité et backends (options retirées de argv, config_execution.hpp)
+    configurerExecution(argc, argv);
+
     if (argv[1] == nullptr) {
-        std::cout << "\nUsage : ./main_t2 <nom-fichier-image>\n"
+        std::cout << "\nUsage : ./main_t2 <nom-fichier-image> [chaine, ex. a,s,g,t]"
+                  << "\n        ./main_t2 --tuiles <entree.pgm> <sortie.pgm> <chaine> [hauteurBande]\n"
                   << std::endl;
         exit(1);
     }
 
+    // Mode tuiles : l'image est lue, traitée et écrite par bandes (valeurs par défaut des trackbars)
+    if (String(argv[1]) == "--tuiles") {
+        if (argc < 5) {
+            std::cout << "\nUsage : ./main_t2 --tuiles <entree.pgm> <sortie.pgm> <chaine> [hauteurBande]\n"
+                      << std::endl;
+            exit(1);
+        }
+        int hauteurBande = (argc > 5) ? atoi(argv[5]) : 256;
+        return executerTuiles(argv[2], argv[3], argv[4], catalogueTP2(20, 20, 1, 50, 100), hauteurBande) ? 0 : 1;
+    }
+
     String filename = argv[1];
     String path = "/home/leodie/Documents/elodie/projects/TP1/";
 
     namedWindow("TP2 - Image");               // crée une fenêtre
-    Mat input = imread(path + argv[1]);     // lit l'image donnée en paramètre
+    Mat input = chargerImage(path + argv[1]);   // lit l'image donnée en paramètre (cache_images.hpp)
+    afficherStatistiquesCache();
 
     // Trackbar pour le rehausseur
     int alpha = 20;
@@ -223,12 +59,22 @@ int main(int, char *argv[]) {
     createTrackbar("longueur (en %)", "TP2 - Image", nullptr, 1000, nullptr);
     setTrackbarPos("longueur (en %)", "TP2 - Image", longueur);
 
+    // Trackbar pour le médian (rayon 1 = fenêtre 3x3)
+    int rayon = 1;
+
+    createTrackbar("rayon median", "TP2 - Image", nullptr, 50, nullptr);
+    setTrackbarPos("rayon median", "TP2 - Image", rayon);
+
     // Conversion de la photo en noir et blanc
     if (input.channels() == 3)
         cv::cvtColor(input, input, COLOR_BGR2GRAY);
 
     Mat output = input.clone();
 
+    // Chaîne de filtres exécutée par la touche 'p'
+    String chaine = (argv[2] != nullptr) ? argv[2] : "";
+    MoteurPipeline moteur;
+
     while (true) {
         int keycode = waitKey(50);
         int asciicode = keycode & 0xff;
@@ -240,7 +86,9 @@ int main(int, char *argv[]) {
                 output = filtreM(input);
                 break;
             case 'm':
-                output = medianBlur(input);
+                // récupère la valeur courante du rayon
+                rayon = getTrackbarPos("rayon median", "TP2 - Image");
+                output = medianBlur(input, rayon);
                 break;
             case 's':
                 // récupère la valeur courante de alpha
@@ -269,6 +117,26 @@ int main(int, char *argv[]) {
                 proportion = getTrackbarPos("proportion (en %)", "TP2 - Image");
                 longueur = getTrackbarPos("longueur (en %)", "TP2 - Image");
                 output = esquisse(input, seuil, alpha, proportion, longueur);
+                break;
+            case 'p': {
+                if (chaine.empty()) {
+                    std::cout << "Aucune chaine donnee (ex. ./main_t2 image.png a,s,g,t)" << std::endl;
+                    break;
+                }
+                std::vector<Etape> etapes;
+                CatalogueEtapes catalogue = catalogueTP2(getTrackbarPos("alpha (en %)", "TP2 - Image"),
+                                                         getTrackbarPos("seuil (en %)", "TP2 - Image"),
+                                                         getTrackbarPos("rayon median", "TP2 - Image"),
+                                                         getTrackbarPos("proportion (en %)", "TP2 - Image"),
+                                                         getTrackbarPos("longueur (en %)", "TP2 - Image"));
+                if (analyserPipeline(chaine, catalogue, etapes)) {
+                    int64 debut = getTickCount();
+                    moteur.executer(etapes, input, output);
+                    std::cout << chaine << " : " << (getTickCount() - debut) * 1000.0 / getTickFrequency()
+                              << " ms" << std::endl;
+                }
+                break;
+            }
             default:
                 break;
         }
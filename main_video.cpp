@@ -1,302 +1,720 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <csignal>
 #include <iostream>
+#include <mutex>
+#include <thread>
 #include "opencv2/imgproc.hpp"
 #include "opencv2/highgui.hpp"
+#include "arena_image.hpp"
+#include "compteur_allocations.hpp"
+#include "config_execution.hpp"
+#include "ordonnanceur.hpp"
+#include "traitements_image.hpp"
 
 using namespace cv;
 
-/** HISTOGRAMME **/
-std::vector<double> histogramme(Mat image) {
-    std::vector<double> histogramme(256, 0.0);
+/** TRAITEMENT D'UNE IMAGE **/
+/* état conservé d'une image à l'autre : rien n'est réalloué une fois la première image traitée */
+struct EtatVideo {
+    String videoType;
+    String functionToExecute;
+    std::vector<Vec3f> palette;                 // genBGR / genCMYK
+    bool incremental = false;                   // tram / genBGR / genCMYK : ne retramer que ce qui bouge
+    std::vector<EtatTramageIncremental> tramageIncremental;     // un par région
+    long long allocationsIncremental = 0;       // allocations faites par le tramage incrémental (--bench)
+    std::vector<Rect> regions;                  // régions d'intérêt (vide : toute l'image)
+    double apercu = 1.0;                        // < 1 : traitement sur l'image réduite de ce facteur
+    std::vector<double> hist = std::vector<double>(256, 0.0);
+    std::vector<double> histCumule = std::vector<double>(256, 0.0);
+    ArenaImage arena;
+};
+
+void initEtatVideo(EtatVideo &etat, const String &videoType, const String &functionToExecute) {
+    etat.videoType = videoType;
+    etat.functionToExecute = functionToExecute;
+
+    if (functionToExecute == "genBGR") {
+        // Fonction générique avec les couleurs BGR
+        etat.palette = palette_generique_BGR();
+    } else if (functionToExecute == "genCMYK") {
+        // Fonction générique avec les couleurs CMYK
+        etat.palette = palette_generique_CMJN();
+    }
+}
 
-    std::vector<Mat> hsv_channels;
-    split(image, hsv_channels);
-    Mat v_image = hsv_channels[2];
+/* traite region (du type de la vidéo) sur place, tramage : état du tramage incrémental de cette région */
+void traiterRegion(Mat region, EtatVideo &etat, EtatTramageIncremental &tramage) {
+    ArenaImage &arena = etat.arena;
+    bool nb = (etat.videoType == "nb");
 
-    for (int i = 0; i < image.rows; i++) {
-        for (int j = 0; j < image.cols; j++) {
-            int lightLevel = (int) v_image.at<uchar>(i, j);
-            histogramme[lightLevel]++;
-        }
+    // Les traitements travaillent en BGR
+    Mat bgr = region;
+    if (nb) {
+        bgr = arena.obtenir(region.size(), CV_8UC3);
+        cvtColor(region, bgr, COLOR_GRAY2BGR);
     }
 
-    for (int i = 0; i < histogramme.size(); i++) {
-        histogramme[i] = histogramme[i] / (image.rows * image.cols);
+    Mat resultat = arena.obtenir(region.size(), CV_8UC3);
+
+    if (etat.functionToExecute == "egal") {
+        /* Conversion BGR to HSV */
+        Mat hsv = arena.obtenir(region.size(), CV_8UC3);
+        cvtColor(bgr, hsv, COLOR_BGR2HSV);
+
+        /* --- Histogrammes --- */
+        histogramme<Vec3b>(hsv, etat.hist);
+        histogramme_cumule(etat.hist, etat.histCumule);
+
+        /* --- Egalisation (sur place), puis histogrammes de l'image égalisée --- */
+        equalization<Vec3b>(hsv, etat.histCumule, hsv);
+        histogramme<Vec3b>(hsv, etat.hist);
+        histogramme_cumule(etat.hist, etat.histCumule);
+
+        /* Conversion HSV to BGR */
+        cvtColor(hsv, resultat, COLOR_HSV2BGR);
+    } else if (etat.incremental) {
+        // palette vide : tramage binaire par canal
+        long long allocationsAvant = nbAllocations;
+        tramage_floyd_steinberg_incremental<Vec3b>(bgr, etat.palette, tramage, resultat);
+        etat.allocationsIncremental += nbAllocations - allocationsAvant;
+    } else if (etat.functionToExecute == "tram") {
+        Mat fs = arena.obtenir(region.size(), CV_32FC3);
+        tramage_floyd_steinberg<Vec3b>(bgr, fs, resultat);
+    } else {
+        Mat fs = arena.obtenir(region.size(), CV_32FC3);
+        tramage_floyd_steinberg_generic(bgr, etat.palette, fs, resultat);
     }
 
-    return histogramme;
+    // Retour au type de la vidéo, dans la région (vue sur l'image de sortie)
+    if (nb) {
+        cvtColor(resultat, region, COLOR_BGR2GRAY);
+    } else {
+        resultat.copyTo(region);
+    }
 }
 
-/** HISTOGRAMME CUMULE **/
-std::vector<double> histogramme_cumule(const std::vector<double> &h_I) {
-    std::vector<double> histogrammeCumule(256, 0.0);
+/* traite frame selon etat, le résultat (du type de la vidéo) est écrit dans edges */
+void traiterImage(const Mat &frame, EtatVideo &etat, Mat &edges) {
+    ArenaImage &arena = etat.arena;
+    arena.nouvelleImage();
+
+    // Aperçu : tout le traitement est fait sur l'image réduite
+    const bool apercu = (etat.apercu < 1.0);
+    Mat image = frame;
+    if (apercu) {
+        image = arena.obtenir(std::max(1, cvRound(frame.rows * etat.apercu)),
+                              std::max(1, cvRound(frame.cols * etat.apercu)), CV_8UC3);
+        resize(frame, image, image.size(), 0, 0, INTER_AREA);
+    }
+
+    // Sélection de la couleur de la vidéo (les pixels hors des régions restent tels quels)
+    bool nb = (etat.videoType == "nb");
+    Mat reduite;
+    if (apercu) reduite = arena.obtenir(image.size(), nb ? CV_8UC1 : CV_8UC3);
+    Mat &sortie = apercu ? reduite : edges;
+    if (nb) {
+        cvtColor(image, sortie, COLOR_BGR2GRAY);
+    } else {
+        image.copyTo(sortie);
+    }
 
-    for (int i = 0; i < h_I.size(); i++) {
-        if (i == 0) {
-            histogrammeCumule[i] = h_I[i];
-        } else {
-            histogrammeCumule[i] = h_I[i] + histogrammeCumule[i - 1];
+    if (etat.functionToExecute != "none") {
+        // Régions d'intérêt (à l'échelle de l'aperçu), ou toute l'image
+        const Rect cadre(0, 0, image.cols, image.rows);
+        const size_t nbRegions = etat.regions.empty() ? 1 : etat.regions.size();
+        if (etat.tramageIncremental.size() != nbRegions) etat.tramageIncremental.resize(nbRegions);
+
+        for (size_t k = 0; k < nbRegions; k++) {
+            Rect region = cadre;
+            if (!etat.regions.empty()) {
+                const Rect &r = etat.regions[k];
+                region = Rect(cvRound(r.x * etat.apercu), cvRound(r.y * etat.apercu),
+                              cvRound(r.width * etat.apercu), cvRound(r.height * etat.apercu)) & cadre;
+            }
+            if (region.area() > 0) traiterRegion(sortie(region), etat, etat.tramageIncremental[k]);
         }
     }
 
-    return histogrammeCumule;
+    // Retour à la taille de la vidéo, sans lissage pour garder les points du tramage
+    if (apercu) {
+        resize(reduite, edges, frame.size(), 0, 0, INTER_NEAREST);
+    }
 }
 
-/** AFFICHAGE DES DEUX HISTOGRAMMES **/
-Mat afficheHistogrammes(const std::vector<double> &h_I, const std::vector<double> &H_I) {
-    Mat image(256, 512, CV_8UC1, 255.0);
-
-    // Affichage de l'histogramme
-    auto maxValue_h_I = std::max_element(h_I.begin(), h_I.end());
-
-    for (int i = 0; i < h_I.size(); i++) {
-        auto newValue = (((h_I[i]) * image.rows) / *maxValue_h_I);
-        for (int j = 0; j < newValue; j++) {
-            image.at<uchar>(image.rows - 1 - j, i) = 0;
+/** SOURCES VIDEO **/
+/* motif mobile généré dans l'image fournie, pour tester sans caméra */
+class SourceSynthetique {
+public:
+    explicit SourceSynthetique(int largeur = 640, int hauteur = 480) : largeur(largeur), hauteur(hauteur) {}
+
+    void lire(Mat &frame) {
+        frame.create(hauteur, largeur, CV_8UC3);
+        int cx = (t * 4) % largeur;
+        int cy = hauteur / 2;
+        for (int i = 0; i < hauteur; i++) {
+            Vec3b *ligne = frame.ptr<Vec3b>(i);
+            for (int j = 0; j < largeur; j++) {
+                bool carre = std::abs(j - cx) < 40 && std::abs(i - cy) < 40;
+                ligne[j] = carre ? Vec3b(255, 255, 255)
+                                 : Vec3b((uchar) (j * 255 / largeur), (uchar) (i * 255 / hauteur), (uchar) ((i + j) & 255));
+            }
         }
+        t++;
     }
 
-    // Affichage de l'histogramme cumulé
-    auto maxValue_H_I = std::max_element(H_I.begin(), H_I.end());
+private:
+    int largeur;
+    int hauteur;
+    int t = 0;
+};
+
+/* caméra (numéro), fichier vidéo, "synth" ou "synth<largeur>x<hauteur>" */
+struct SourceVideo {
+    VideoCapture capture;
+    SourceSynthetique synthetique;
+    bool estSynthetique = false;
+
+    bool ouvrir(const String &nom) {
+        if (nom.compare(0, 5, "synth") == 0) {
+            int largeur = 640, hauteur = 480;
+            if (nom.size() > 5 && sscanf(nom.c_str() + 5, "%dx%d", &largeur, &hauteur) != 2) return false;
+            synthetique = SourceSynthetique(largeur, hauteur);
+            estSynthetique = true;
+            return true;
+        }
+        if (!nom.empty() && nom.find_first_not_of("0123456789") == String::npos) {
+            capture.open(atoi(nom.c_str()));
+        } else {
+            capture.open(nom);
+        }
+        return capture.isOpened();
+    }
 
-    for (int i = 0; i < H_I.size(); i++) {
-        auto newValue = (((H_I[i]) * image.rows) / *maxValue_H_I);
-        for (int j = 0; j < newValue; j++) {
-            image.at<uchar>(image.rows - 1 - j, h_I.size() + i) = 0;
+    bool lire(Mat &frame) {
+        if (estSynthetique) {
+            synthetique.lire(frame);
+            return true;
         }
+        return capture.read(frame) && !frame.empty();
     }
+};
 
-    return image;
+/** ARRET **/
+/* sans fenêtre, pas de touche 'q' : SIGINT (Ctrl+C) et SIGTERM arrêtent la lecture, les statistiques sont affichées */
+static std::atomic<bool> arretDemande(false);
+
+void demanderArret(int) {
+    arretDemande = true;
 }
 
-/** EGALISATION **/
-Mat equalization(Mat image, std::vector<double> &h_I, std::vector<double> &H_I) {
-    std::vector<Mat> hsv_channels;
-    split(image, hsv_channels);
+/** UTILISATION **/
+void usage() {
+    std::cout << "\nUsage : ./main_video <nb | color> <egal | tram | genBGR | genCMYK | none>"
+              << " [--source <numero | fichier | synth[<l>x<h>]>[@operation]]... [--bench <nbImages>] [--incremental]"
+              << "\n        [--roi <x>,<y>,<largeur>,<hauteur>]... [--apercu <facteur>] [--affichage <hz | off>]\n"
+              << std::endl;
+    exit(1);
+}
 
-    // Parcours tout les pixels de l'image
-    for (int i = 0; i < image.rows; i++) {
-        for (int j = 0; j < image.cols; j++) {
-            int lightLevel = (int) hsv_channels[2].at<uchar>(i, j);
-            hsv_channels[2].at<uchar>(i, j) = 255.0 * (double) H_I[lightLevel];
+/** FLUX MULTIPLES **/
+/**
+ * Plusieurs sources traitées en même temps sur un seul Ordonnanceur.
+ *
+ * Chaque flux a un thread de lecture et quelques emplacements (une image, son
+ * résultat et son EtatVideo, donc ses tampons) : une image lue est traitée
+ * par une tâche du pool dès qu'un emplacement est libre, si bien que plusieurs
+ * images d'un même flux et des images de flux différents sont traitées en
+ * parallèle. Les résultats sont rendus dans l'ordre de lecture de chaque flux ;
+ * en tramage incrémental, qui dépend de l'image précédente, un flux n'a qu'un
+ * emplacement.
+ */
+enum StatutEmplacement {
+    EMPLACEMENT_LIBRE,
+    EMPLACEMENT_EN_COURS,
+    EMPLACEMENT_TERMINE
+};
+
+struct EmplacementImage {
+    EtatVideo etat;
+    Mat frame;
+    Mat resultat;
+    long long numero = 0;
+    int64 lecture = 0;          // getTickCount() à la lecture
+    StatutEmplacement statut = EMPLACEMENT_LIBRE;
+};
+
+struct FluxVideo {
+    String nom;
+    String operation;
+    SourceVideo source;
+    std::vector<std::unique_ptr<EmplacementImage>> emplacements;
+
+    std::mutex verrou;
+    std::condition_variable emplacementLibre;
+    long long prochainRendu = 0;        // prochaine image à rendre, dans l'ordre de lecture
+    Mat affichage;                      // dernier résultat rendu
+    bool nouvelAffichage = false;
+
+    // statistiques
+    std::vector<double> latences;       // ms entre la lecture et le rendu
+    int64 premiereLecture = 0;
+    int64 dernierRendu = 0;
+};
+
+/* rend, dans l'ordre, les images terminées du flux (verrou du flux tenu) */
+void rendreImagesTerminees(FluxVideo &flux, bool affichage) {
+    bool rendu = true;
+    while (rendu) {
+        rendu = false;
+        for (size_t e = 0; e < flux.emplacements.size(); e++) {
+            EmplacementImage &emplacement = *flux.emplacements[e];
+            if (emplacement.statut != EMPLACEMENT_TERMINE || emplacement.numero != flux.prochainRendu) continue;
+
+            flux.dernierRendu = getTickCount();
+            flux.latences.push_back((flux.dernierRendu - emplacement.lecture) * 1000.0 / getTickFrequency());
+            if (affichage) {
+                emplacement.resultat.copyTo(flux.affichage);
+                flux.nouvelAffichage = true;
+            }
+            emplacement.statut = EMPLACEMENT_LIBRE;
+            flux.prochainRendu++;
+            rendu = true;
         }
     }
-
-    merge(hsv_channels, image);
-
-    h_I = histogramme(image);
-    H_I = histogramme_cumule(h_I);
-
-    return image;
+    flux.emplacementLibre.notify_all();
 }
 
-/** TRAMAGE FLOYD STEINBERG (pour BGR) **/
-void tramage_floyd_steinberg(Mat input, Mat output) {
-    input.convertTo(input, CV_32FC3);
-
-    std::vector<Mat> channels;
-    split(input, channels);
-
-    for (int n = 0; n < channels.size(); n++) {
-        // pour chaque x de gauche à droite
-        for (int y = 0; y < channels[n].cols - 1; y++) {
-            // pour chaque y de haut en bas
-            for (int x = 1; x < channels[n].rows - 1; x++) {
-                float ancien_pixel = channels[n].at<float>(x, y);
-                float nouveau_pixel = (ancien_pixel > 128.0) ? 255.0 : 0.0;
-                channels[n].at<float>(x, y) = nouveau_pixel;
-                float erreur_quantification = ancien_pixel - nouveau_pixel;
-                channels[n].at<float>(x + 1, y) =
-                        channels[n].at<float>(x + 1, y) + (7.0 / 16.0 * erreur_quantification);
-                channels[n].at<float>(x - 1, y + 1) =
-                        channels[n].at<float>(x - 1, y + 1) + (3.0 / 16.0 * erreur_quantification);
-                channels[n].at<float>(x, y + 1) =
-                        channels[n].at<float>(x, y + 1) + (5.0 / 16.0 * erreur_quantification);
-                channels[n].at<float>(x + 1, y + 1) =
-                        channels[n].at<float>(x + 1, y + 1) + (1.0 / 16.0 * erreur_quantification);
+/* thread de lecture d'un flux : nbImages images (0 : jusqu'à la fin de la source ou à l'arrêt) */
+void lireFlux(FluxVideo &flux, Ordonnanceur &ordonnanceur, int nbImages, bool affichage,
+              const std::atomic<bool> &arret, std::atomic<int> &nbFluxActifs) {
+    for (long long numero = 0; !arret && (nbImages == 0 || numero < nbImages); numero++) {
+        // attend un emplacement libre
+        EmplacementImage *emplacement = nullptr;
+        {
+            std::unique_lock<std::mutex> verrou(flux.verrou);
+            for (;;) {
+                for (size_t e = 0; e < flux.emplacements.size() && emplacement == nullptr; e++) {
+                    if (flux.emplacements[e]->statut == EMPLACEMENT_LIBRE) emplacement = flux.emplacements[e].get();
+                }
+                if (emplacement != nullptr) break;
+                flux.emplacementLibre.wait(verrou);
             }
+            emplacement->statut = EMPLACEMENT_EN_COURS;
+        }
+
+        // l'emplacement est réservé : lecture hors du verrou
+        if (!flux.source.lire(emplacement->frame)) {
+            std::lock_guard<std::mutex> garde(flux.verrou);
+            emplacement->statut = EMPLACEMENT_LIBRE;
+            break;
         }
+        emplacement->numero = numero;
+        emplacement->lecture = getTickCount();
+        if (numero == 0) flux.premiereLecture = emplacement->lecture;
+
+        ordonnanceur.soumettre([&flux, emplacement, affichage]() {
+            traiterImage(emplacement->frame, emplacement->etat, emplacement->resultat);
+            std::lock_guard<std::mutex> garde(flux.verrou);
+            emplacement->statut = EMPLACEMENT_TERMINE;
+            rendreImagesTerminees(flux, affichage);
+        });
     }
 
-    merge(channels, output);
-    output.convertTo(output, CV_8UC3);
+    // attend les images en cours
+    std::unique_lock<std::mutex> verrou(flux.verrou);
+    flux.emplacementLibre.wait(verrou, [&flux]() {
+        for (size_t e = 0; e < flux.emplacements.size(); e++) {
+            if (flux.emplacements[e]->statut != EMPLACEMENT_LIBRE) return false;
+        }
+        return true;
+    });
+    nbFluxActifs--;
 }
 
-/** FONCTION POUR LE TRAMAGE GENERIQUE **/
-/* distance entre deux couleurs */
-float distance_color_l2(Vec3f bgr1, Vec3f bgr2) {
-    return sqrt(
-            (bgr1[0] - bgr2[0]) * (bgr1[0] - bgr2[0])
-            + (bgr1[1] - bgr2[1]) * (bgr1[1] - bgr2[1])
-            + (bgr1[2] - bgr2[2]) * (bgr1[2] - bgr2[2]));
+void afficherStatistiquesFlux(FluxVideo &flux) {
+    std::vector<double> latences = flux.latences;
+    std::sort(latences.begin(), latences.end());
+    double duree = (flux.dernierRendu - flux.premiereLecture) / getTickFrequency();
+    std::cout << flux.nom << " (" << flux.operation << ", " << flux.affichage.cols << "x" << flux.affichage.rows
+              << ") : " << latences.size() << " images, " << (duree > 0 ? latences.size() / duree : 0.0)
+              << " images/s";
+    if (!latences.empty()) {
+        std::cout << ", latence p50 " << latences[latences.size() / 2] << " ms, p99 "
+                  << latences[std::min(latences.size() - 1, latences.size() * 99 / 100)] << " ms";
+    }
+    std::cout << std::endl;
 }
 
-/* retourne l'indice de la couleur la plus proche du vecteur donné */
-int best_color(Vec3f bgr, std::vector<Vec3f> colors) {
-    int i = -1;
-    float minDist = INFINITY;
+/* sources : "nom" ou "nom@operation" ; nbImagesBench > 0 ou periodeAffichage nulle : sans affichage */
+int executerFluxMultiples(const std::vector<String> &sources, const String &videoType,
+                          const String &functionToExecute, bool incremental, int nbImagesBench,
+                          const std::vector<Rect> &regions, double apercu, int periodeAffichage) {
+    // le parallélisme vient des images traitées en même temps, pas de l'intérieur de chaque traitement
+    Ordonnanceur ordonnanceur(getNumThreads());
+    setNumThreads(1);
+
+    const bool affichage = (nbImagesBench == 0 && periodeAffichage > 0);
+    const int nbEmplacements = std::max(2, 2 * ordonnanceur.nbThreads() / (int) sources.size());
+
+    std::vector<std::unique_ptr<FluxVideo>> flux;
+    for (size_t i = 0; i < sources.size(); i++) {
+        FluxVideo *f = new FluxVideo();
+        flux.push_back(std::unique_ptr<FluxVideo>(f));
+
+        size_t arobase = sources[i].find('@');
+        f->nom = sources[i].substr(0, arobase);
+        f->operation = (arobase == String::npos) ? functionToExecute : sources[i].substr(arobase + 1);
+        if (f->operation != "egal" && f->operation != "tram" && f->operation != "genBGR"
+            && f->operation != "genCMYK" && f->operation != "none") {
+            usage();
+        }
+        if (!f->source.ouvrir(f->nom)) {
+            std::cout << "Impossible d'ouvrir " << f->nom << std::endl;
+            return -1;
+        }
 
-    for (int n = 0; n < colors.size(); n++) {
-        float dist = distance_color_l2(bgr, colors[n]);
-        if (dist < minDist) {
-            i = n;
-            minDist = dist;
+        bool fluxIncremental = incremental && f->operation != "egal" && f->operation != "none";
+        for (int e = 0; e < (fluxIncremental ? 1 : nbEmplacements); e++) {
+            EmplacementImage *emplacement = new EmplacementImage();
+            initEtatVideo(emplacement->etat, videoType, f->operation);
+            emplacement->etat.incremental = fluxIncremental;
+            emplacement->etat.regions = regions;
+            emplacement->etat.apercu = apercu;
+            f->emplacements.push_back(std::unique_ptr<EmplacementImage>(emplacement));
         }
+        f->latences.reserve(nbImagesBench > 0 ? nbImagesBench : 1024);
     }
 
-    return i;
-}
+    std::atomic<bool> &arret = arretDemande;
+    std::atomic<int> nbFluxActifs((int) flux.size());
+    std::vector<std::thread> lecteurs;
+    int64 debut = getTickCount();
+    for (size_t i = 0; i < flux.size(); i++) {
+        lecteurs.push_back(std::thread(lireFlux, std::ref(*flux[i]), std::ref(ordonnanceur), nbImagesBench,
+                                       affichage, std::cref(arret), std::ref(nbFluxActifs)));
+    }
 
-/* retourne le vecteur d'erreur entre 2 couleurs */
-Vec3f error_color(Vec3f bgr1, Vec3f bgr2) {
-    return {bgr1[0] - bgr2[0], bgr1[1] - bgr2[1], bgr1[2] - bgr2[2]};
+    // affichage dans le thread principal : dernière image rendue de chaque flux. Sous le verrou, seulement un
+    // échange de tampons (le flux récupère celui déjà affiché) : le rendu des images n'attend jamais imshow
+    std::vector<Mat> imagesAffichees(flux.size());
+    while (affichage && !arret && nbFluxActifs > 0) {
+        for (size_t i = 0; i < flux.size(); i++) {
+            bool nouvelle;
+            {
+                std::lock_guard<std::mutex> garde(flux[i]->verrou);
+                nouvelle = flux[i]->nouvelAffichage;
+                if (nouvelle) {
+                    std::swap(imagesAffichees[i], flux[i]->affichage);
+                    flux[i]->nouvelAffichage = false;
+                }
+            }
+            if (nouvelle) imshow(flux[i]->nom, imagesAffichees[i]);
+        }
+        if ((waitKey(periodeAffichage) & 0xff) == 'q') arret = true;
+    }
+
+    for (size_t i = 0; i < lecteurs.size(); i++) lecteurs[i].join();
+    double duree = (getTickCount() - debut) / getTickFrequency();
+
+    size_t total = 0;
+    for (size_t i = 0; i < flux.size(); i++) {
+        if (flux[i]->affichage.empty()) flux[i]->emplacements[0]->resultat.copyTo(flux[i]->affichage);
+        afficherStatistiquesFlux(*flux[i]);
+        total += flux[i]->latences.size();
+    }
+    std::cout << "total : " << total / duree << " images/s sur " << ordonnanceur.nbThreads() << " threads"
+              << std::endl;
+    return 0;
 }
 
-/* Tramage Floyd Steinberg générique */
-Mat tramage_floyd_steinberg_generic(Mat input, std::vector<Vec3f> colors) {
-    // Conversion de input en une matrice de 3 canaux flottants
-    Mat fs;
-    input.convertTo(fs, CV_32FC3, 1 / 255.0);
-
-    // Algorithme Floyd-Steinberg
-    for (int y = 0; y < fs.cols - 1; y++) {
-        for (int x = 1; x < fs.rows - 1; x++) {
-            Vec3f c = fs.at<Vec3f>(x, y);
-            int i = best_color(c, colors);
-            Vec3f e = error_color(c, colors[i]);
-            fs.at<Vec3f>(x, y) = colors[i];
-
-            // On propage e aux pixels voisins
-            fs.at<Vec3f>(x + 1, y) = fs.at<Vec3f>(x + 1, y) + (7.0 / 16.0 * e);
-            fs.at<Vec3f>(x - 1, y + 1) =
-                    fs.at<Vec3f>(x - 1, y + 1) + (3.0 / 16.0 * e);
-            fs.at<Vec3f>(x, y + 1) =
-                    fs.at<Vec3f>(x, y + 1) + (5.0 / 16.0 * e);
-            fs.at<Vec3f>(x + 1, y + 1) =
-                    fs.at<Vec3f>(x + 1, y + 1) + (1.0 / 16.0 * e);
+/** AFFICHAGE DECOUPLE DU TRAITEMENT **/
+/* échanges entre le thread de traitement et l'affichage (thread principal) */
+struct ImagePartagee {
+    std::mutex verrou;
+    Mat image;                              // dernier résultat
+    std::vector<double> hist;
+    std::vector<double> histCumule;
+    bool nouvelle = false;
+    Mat pleine;                             // résultat en pleine résolution demandé par 'f'
+    bool nouvellePleine = false;
+    bool demandePleine = false;
+    std::vector<Rect> regions;              // modifiées à la souris
+    bool regionsModifiees = false;
+};
+
+/* lit et traite les images sans attendre l'affichage ; partage nul : rien n'est publié */
+long long boucleTraitement(SourceVideo &sourceVideo, EtatVideo &etat, EtatVideo &etatPleine, ImagePartagee *partage,
+                           const std::atomic<bool> &arret) {
+    Mat frame, edges, pleine;
+    long long nbImages = 0;
+    while (!arret && sourceVideo.lire(frame)) {
+        if (partage != nullptr) {
+            std::lock_guard<std::mutex> garde(partage->verrou);
+            if (partage->regionsModifiees) {
+                etat.regions = partage->regions;
+                partage->regionsModifiees = false;
+            }
+        }
+
+        traiterImage(frame, etat, edges);
+        nbImages++;
+        if (partage == nullptr) continue;
+
+        // publication par échange de tampons : l'affichage garde toujours une image complète
+        bool demandePleine;
+        {
+            std::lock_guard<std::mutex> garde(partage->verrou);
+            std::swap(partage->image, edges);
+            partage->hist = etat.hist;
+            partage->histCumule = etat.histCumule;
+            partage->nouvelle = true;
+            demandePleine = partage->demandePleine;
+            partage->demandePleine = false;
+        }
+        if (demandePleine) {
+            etatPleine.regions = etat.regions;
+            traiterImage(frame, etatPleine, pleine);
+            std::lock_guard<std::mutex> garde(partage->verrou);
+            std::swap(partage->pleine, pleine);
+            partage->nouvellePleine = true;
         }
     }
+    return nbImages;
+}
 
-    // On reconvertit la matrice de 3 canaux flottants en BGR
-    Mat output;
-    fs.convertTo(output, CV_8UC3, 255.0);
-    return output;
+/** SELECTION DES REGIONS A LA SOURIS **/
+/* glisser : ajoute une région, clic droit : les efface toutes (l'image est alors traitée en entier) */
+struct SelectionRegions {
+    ImagePartagee *partage;
+    Point debut;
+    bool enCours = false;
+};
+
+void selectionSouris(int event, int x, int y, int, void *donnees) {
+    SelectionRegions &selection = *(SelectionRegions *) donnees;
+    if (event == EVENT_LBUTTONDOWN) {
+        selection.debut = Point(x, y);
+        selection.enCours = true;
+    } else if (event == EVENT_LBUTTONUP && selection.enCours) {
+        selection.enCours = false;
+        Rect region(selection.debut, Point(x, y));
+        if (region.area() > 0) {
+            std::lock_guard<std::mutex> garde(selection.partage->verrou);
+            selection.partage->regions.push_back(region);
+            selection.partage->regionsModifiees = true;
+        }
+    } else if (event == EVENT_RBUTTONDOWN) {
+        std::lock_guard<std::mutex> garde(selection.partage->verrou);
+        selection.partage->regions.clear();
+        selection.partage->regionsModifiees = true;
+    }
 }
 
 /** MAIN **/
-int main(int, char *argv[])
+int main(int argc, char *argv[])
 {
-    VideoCapture cap(0);
-    if(!cap.isOpened()) return -1;
-    Mat frame, edges;
-    namedWindow("edges", WINDOW_AUTOSIZE);
+    // threads, affinité et backends (options retirées de argv, config_execution.hpp)
+    configurerExecution(argc, argv);
 
     if (argv[1] == nullptr || argv[2] == nullptr) {
-        std::cout << "\nUsage : ./main_video <nb | color> <egal | tram | genBGR | genCMYK | none>\n" << std::endl;
-        exit(1);
+        usage();
     }
 
-    for(;;)
-    {
-        cap >> frame;
-        String videoType = (String) argv[1];
-
-        // Sélection de la couleur de la vidéo
-        if (videoType == "nb") {
-            cvtColor(frame, edges, COLOR_BGR2GRAY);
-        } else if (videoType == "color") {
-            frame.copyTo(edges);
+    String videoType = (String) argv[1];
+    String functionToExecute = argv[2];
+    std::vector<String> sources;
+    int nbImagesBench = 0;
+    bool incremental = false;
+    std::vector<Rect> regions;
+    double apercu = 1.0;
+    int periodeAffichage = 33;      // ms entre deux rafraîchissements, 0 : pas d'affichage
+
+    for (int i = 3; i < argc; i++) {
+        String option = argv[i];
+        if (option == "--source" && i + 1 < argc) {
+            sources.push_back(argv[++i]);
+        } else if (option == "--bench" && i + 1 < argc) {
+            nbImagesBench = atoi(argv[++i]);
+        } else if (option == "--incremental") {
+            incremental = true;
+        } else if (option == "--roi" && i + 1 < argc) {
+            Rect region;
+            if (sscanf(argv[++i], "%d,%d,%d,%d", &region.x, &region.y, &region.width, &region.height) != 4) usage();
+            regions.push_back(region);
+        } else if (option == "--affichage" && i + 1 < argc) {
+            String frequence = argv[++i];
+            if (frequence == "off") {
+                periodeAffichage = 0;
+            } else if (atof(frequence.c_str()) > 0.0) {
+                periodeAffichage = std::max(1, cvRound(1000.0 / atof(frequence.c_str())));
+            } else {
+                usage();
+            }
+        } else if (option == "--apercu" && i + 1 < argc) {
+            apercu = atof(argv[++i]);
+            if (apercu <= 0.0 || apercu > 1.0) usage();
+        } else {
+            usage();
         }
+    }
 
-        /** --- DEBUT DES APPELS DE FONCTIONS --- **/
-        String functionToExecute = argv[2];
+    if ((videoType != "nb" && videoType != "color")
+        || (functionToExecute != "egal" && functionToExecute != "tram" && functionToExecute != "genBGR"
+            && functionToExecute != "genCMYK" && functionToExecute != "none")) {
+        usage();
+    }
 
-        if (functionToExecute == "egal") {
-            /* Conversion BGR to HSV */
-            if (videoType == "nb") {
-                cvtColor(edges, edges, COLOR_GRAY2BGR);
-            }
+    // une caméra ne s'arrête pas d'elle-même : sans fenêtre, Ctrl+C termine proprement
+    if (periodeAffichage == 0) {
+        signal(SIGINT, demanderArret);
+        signal(SIGTERM, demanderArret);
+    }
 
-            cvtColor(edges, edges, COLOR_BGR2HSV);
+    // Plusieurs sources (ou une opération par source) : traitées ensemble sur un pool de threads partagé
+    if (sources.size() > 1 || (sources.size() == 1 && sources[0].find('@') != String::npos)) {
+        return executerFluxMultiples(sources, videoType, functionToExecute, incremental, nbImagesBench, regions,
+                                     apercu, periodeAffichage);
+    }
 
-            /* --- Histogrammes --- */
-            std::vector<double> hist = histogramme(edges);
-            std::vector<double> histCumule = histogramme_cumule(hist);
+    SourceVideo sourceVideo;
+    if (!sourceVideo.ouvrir(sources.empty() ? "0" : sources[0])) return -1;
 
-            /* --- Egalisation --- */
-            Mat equalizedVideo = equalization(edges, hist, histCumule);
+    EtatVideo etat;
+    initEtatVideo(etat, videoType, functionToExecute);
+    etat.incremental = incremental && functionToExecute != "egal" && functionToExecute != "none";
+    etat.regions = regions;
+    etat.apercu = apercu;
+    Mat frame, edges;
 
-            /* Conversion HSV to BGR */
-            if (videoType == "nb") {
-                cvtColor(edges, edges, COLOR_BGR2GRAY);
-            }
-            cvtColor(equalizedVideo, equalizedVideo, COLOR_HSV2BGR);
+    /** --- MESURE : temps et allocations par image, sans affichage --- **/
+    if (nbImagesBench > 0) {
+        // les premières images allouent les tampons de l'arène
+        for (int i = 0; i < 5; i++) {
+            if (!sourceVideo.lire(frame)) return -1;
+            traiterImage(frame, etat, edges);
+        }
 
-            // Affichage des histogrammes
-            Mat displayHistogrammes = afficheHistogrammes(hist, histCumule);
-            namedWindow("Histogrammes Video");
-            imshow("Histogrammes Video", displayHistogrammes);                // l'affiche dans la fenêtre
-        } else if (functionToExecute == "tram") {
-            if (videoType == "nb") {
-                cvtColor(edges, edges, COLOR_GRAY2BGR);
+        // allocations comptées pendant le traitement seul : le décodage d'une caméra ou d'un fichier alloue
+        long long allocations = 0;
+        etat.allocationsIncremental = 0;
+        int64 debut = getTickCount();
+        int nbImages = 0;
+        double proportionRetramee = 0.0;
+        for (; nbImages < nbImagesBench; nbImages++) {
+            if (!sourceVideo.lire(frame)) break;
+            long long allocationsAvant = nbAllocations;
+            traiterImage(frame, etat, edges);
+            allocations += nbAllocations - allocationsAvant;
+            for (size_t k = 0; k < etat.tramageIncremental.size(); k++) {
+                proportionRetramee += etat.tramageIncremental[k].proportionRetramee / etat.tramageIncremental.size();
             }
+        }
+        double duree = (getTickCount() - debut) * 1000.0 / getTickFrequency();
+
+        std::cout << functionToExecute << " (" << videoType << ", " << frame.cols << "x" << frame.rows << ") : "
+                  << duree / std::max(nbImages, 1) << " ms/image, "
+                  << (double) allocations / std::max(nbImages, 1) << " allocations/image";
+        if (etat.incremental) {
+            std::cout << ", " << 100.0 * proportionRetramee / std::max(nbImages, 1) << " % de blocs retramés, "
+                      << (double) etat.allocationsIncremental / std::max(nbImages, 1)
+                      << " allocations/image dans le tramage incrémental";
+        }
+        std::cout << std::endl;
 
-            Mat tramedVideo(edges.rows, edges.cols, CV_32FC3);
-            tramage_floyd_steinberg(edges, tramedVideo);
-            tramedVideo.copyTo(edges);
-
-            if (videoType == "nb") {
-                cvtColor(edges, edges, COLOR_BGR2GRAY);
-            }
-        } else if (functionToExecute == "genBGR") {
-            if (videoType == "nb") {
-                cvtColor(edges, edges, COLOR_GRAY2BGR);
-            }
+        // le tramage incrémental garde tous ses tampons : une fois la première image tramée, il n'alloue plus rien
+        if (etat.incremental && etat.allocationsIncremental > 0) {
+            std::cout << "Erreur : le tramage incrémental alloue en régime établi" << std::endl;
+            return 1;
+        }
+        return 0;
+    }
 
-            Vec3f blue({1.0, 0.0, 0.0});
-            Vec3f green({0.0, 1.0, 0.0});
-            Vec3f red({0.0, 0.0, 1.0});
-            Vec3f black({0.0, 0.0, 0.0});
-            Vec3f white({1.0, 1.0, 1.0});
+    // Résultat en pleine résolution à la demande (touche 'f') pendant l'aperçu, avec son propre état
+    EtatVideo etatPleine;
+    initEtatVideo(etatPleine, videoType, functionToExecute);
+    std::atomic<bool> &arret = arretDemande;
+
+    /** --- SANS AFFICHAGE : débit de traitement seul --- **/
+    if (periodeAffichage == 0) {
+        int64 debut = getTickCount();
+        long long nbImages = boucleTraitement(sourceVideo, etat, etatPleine, nullptr, arret);
+        double duree = (getTickCount() - debut) / getTickFrequency();
+        std::cout << nbImages << " images, " << nbImages / std::max(duree, 1e-9) << " images/s" << std::endl;
+        return 0;
+    }
 
-            // Fonction générique avec les couleurs BGR
-            std::vector<Vec3f> colorsBGR = {blue, green, red, black, white};
-            Mat tramedVideo = tramage_floyd_steinberg_generic(edges, colorsBGR);
-            tramedVideo.copyTo(edges);
+    namedWindow("edges", WINDOW_AUTOSIZE);
+    if (functionToExecute == "egal") {
+        namedWindow("Histogrammes Video");
+    }
 
-            if (videoType == "nb") {
-                cvtColor(edges, edges, COLOR_BGR2GRAY);
+    // Régions d'intérêt choisies à la souris, en coordonnées de l'image complète
+    ImagePartagee partage;
+    partage.regions = etat.regions;
+    SelectionRegions selection;
+    selection.partage = &partage;
+    setMouseCallback("edges", selectionSouris, &selection);
+
+    /** --- DEBUT DES APPELS DE FONCTIONS --- **/
+    // Le traitement tourne dans son propre thread ; le thread principal affiche la dernière image au plus
+    // une fois par periodeAffichage (HighGUI reste ainsi sur un seul thread)
+    std::atomic<bool> fini(false);
+    std::thread traitement([&]() {
+        boucleTraitement(sourceVideo, etat, etatPleine, &partage, arret);
+        fini = true;
+    });
+
+    RenduHistogrammes renduHistogrammes;
+    Mat displayHistogrammes;
+    // tampons propres à l'affichage : sous le verrou, seulement des échanges avec ceux du partage,
+    // pour que la publication du thread de traitement n'attende jamais le dessin ni imshow
+    Mat imageAffichee, pleineAffichee;
+    std::vector<double> histAffiche, histCumuleAffiche;
+    while (!fini) {
+        bool nouvelle, nouvellePleine;
+        {
+            std::lock_guard<std::mutex> garde(partage.verrou);
+            nouvelle = partage.nouvelle;
+            if (nouvelle) {
+                std::swap(imageAffichee, partage.image);
+                std::swap(histAffiche, partage.hist);
+                std::swap(histCumuleAffiche, partage.histCumule);
+                partage.nouvelle = false;
             }
-        } else if (functionToExecute == "genCMYK") {
-            if (videoType == "nb") {
-                cvtColor(edges, edges, COLOR_GRAY2BGR);
+            nouvellePleine = partage.nouvellePleine;
+            if (nouvellePleine) {
+                std::swap(pleineAffichee, partage.pleine);
+                partage.nouvellePleine = false;
             }
+        }
 
-            Vec3f cyan({1.0, 1.0, 0.0});
-            Vec3f magenta({1.0, 0.0, 1.0});
-            Vec3f yellow({0.0, 1.0, 1.0});
-            Vec3f black({0.0, 0.0, 0.0});
-            Vec3f white({1.0, 1.0, 1.0});
-
-            // Fonction générique avec les couleurs CMYK
-            std::vector<Vec3f> colorsCMJN = {cyan, magenta, yellow, black, white};
-            Mat tramedVideo = tramage_floyd_steinberg_generic(edges, colorsCMJN);
-            tramedVideo.copyTo(edges);
+        if (nouvelle) {
+            // Affichage de la vidéo
+            imshow("edges", imageAffichee);
 
-            if (videoType == "nb") {
-                cvtColor(edges, edges, COLOR_BGR2GRAY);
+            // Affichage des histogrammes
+            if (functionToExecute == "egal") {
+                renduHistogrammes.dessiner(histAffiche, histCumuleAffiche, displayHistogrammes);
+                imshow("Histogrammes Video", displayHistogrammes);                // l'affiche dans la fenêtre
             }
-        } else if (functionToExecute != "none" ){
-            std::cout << "\nUsage : ./main_video <nb | color> <egal | tram | genBGR | genCMYK | none>\n" << std::endl;
-            exit(1);
+        }
+        if (nouvellePleine) {
+            imshow("Pleine resolution", pleineAffichee);
         }
 
-        // Affichage de la vidéo
-        imshow("edges", edges);
-        int   key_code = waitKey(30);
+        int   key_code = waitKey(periodeAffichage);
         int ascii_code = key_code & 0xff;
         if( ascii_code == 'q') break;
-
-        /** --- FIN DES APPELS DE FONCTIONS --- **/
+        if (ascii_code == 'f' && etat.apercu < 1.0) {
+            std::lock_guard<std::mutex> garde(partage.verrou);
+            partage.demandePleine = true;
+        }
     }
+    /** --- FIN DES APPELS DE FONCTIONS --- **/
+
+    arret = true;
+    traitement.join();
     return 0;
 }
@@ -0,0 +1,137 @@
+#ifndef TP_MEDIAN_CONSTANT_HPP
+#define TP_MEDIAN_CONSTANT_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+#include "compteurs_perf.hpp"
+#include "config_execution.hpp"
+
+/**
+ * Filtre médian en temps constant (Perreault & Hébert, 2007) pour CV_8UC1.
+ *
+ * Chaque colonne garde l'histogramme de ses 2r+1 pixels verticaux, mis à jour
+ * d'une ligne à l'autre (un retrait, un ajout). L'histogramme de la fenêtre
+ * glisse ensuite d'une colonne à l'autre en ajoutant/retirant un histogramme
+ * de colonne. Les histogrammes sont à deux niveaux (16 cases grossières de
+ * 16 cases fines) et les cases fines de la fenêtre ne sont mises à jour qu'au
+ * moment où la recherche de la médiane en a besoin : le coût par pixel ne
+ * dépend pas du rayon. L'image est découpée en bandes verticales traitées en
+ * parallèle. Les bords sont répliqués comme pour medianBlur.
+ */
+
+/* traite les colonnes [x0, x1) de src */
+inline void medianBandeVerticale(const cv::Mat &src, cv::Mat &dst, int rayon, int x0, int x1) {
+    const int n = 2 * rayon + 1;
+    const int rang = (n * n) / 2;
+    const int nbColonnes = (x1 - x0) + 2 * rayon;   // colonnes [x0 - r, x1 + r)
+    const int cMin = x0 - rayon;
+
+    std::vector<ushort> colFine(nbColonnes * 256, 0);
+    std::vector<ushort> colGrossier(nbColonnes * 16, 0);
+
+    // indice (dans l'image) de la colonne locale c, bord répliqué
+    std::vector<int> xImage(nbColonnes);
+    for (int c = 0; c < nbColonnes; c++) {
+        xImage[c] = std::min(std::max(cMin + c, 0), src.cols - 1);
+    }
+
+    auto ajouter = [&](int y, int signe) {
+        const uchar *ligne = src.ptr<uchar>(std::min(std::max(y, 0), src.rows - 1));
+        for (int c = 0; c < nbColonnes; c++) {
+            uchar v = ligne[xImage[c]];
+            colFine[c * 256 + v] += signe;
+            colGrossier[c * 16 + (v >> 4)] += signe;
+        }
+    };
+
+    for (int y = -rayon; y <= rayon; y++) ajouter(y, 1);
+
+    ushort noyauGrossier[16];
+    ushort noyauFin[16 * 16];
+    int prochaineColonne[16];   // première colonne locale pas encore ajoutée à la case fine k
+
+    for (int y = 0; y < src.rows; y++) {
+        if (y > 0) {
+            ajouter(y - rayon - 1, -1);
+            ajouter(y + rayon, 1);
+        }
+
+        std::memset(noyauGrossier, 0, sizeof(noyauGrossier));
+        for (int c = 0; c < n; c++) {
+            for (int k = 0; k < 16; k++) noyauGrossier[k] += colGrossier[c * 16 + k];
+        }
+        for (int k = 0; k < 16; k++) prochaineColonne[k] = -2 * n;
+
+        uchar *sortie = dst.ptr<uchar>(y);
+
+        for (int x = x0; x < x1; x++) {
+            const int c = x - cMin;     // colonne locale du centre, fenêtre [c - r, c + r]
+            if (x > x0) {
+                const ushort *entree = &colGrossier[(c + rayon) * 16];
+                const ushort *sortante = &colGrossier[(c - rayon - 1) * 16];
+                for (int k = 0; k < 16; k++) noyauGrossier[k] += entree[k] - sortante[k];
+            }
+
+            // case grossière contenant la médiane
+            int k = 0;
+            int cumul = 0;
+            while (cumul + noyauGrossier[k] <= rang) {
+                cumul += noyauGrossier[k];
+                k++;
+            }
+
+            // mise à jour paresseuse de la case fine k
+            ushort *fin = &noyauFin[k * 16];
+            if (prochaineColonne[k] <= c - rayon) {
+                std::memset(fin, 0, 16 * sizeof(ushort));
+                for (int cc = c - rayon; cc <= c + rayon; cc++) {
+                    const ushort *h = &colFine[cc * 256 + k * 16];
+                    for (int i = 0; i < 16; i++) fin[i] += h[i];
+                }
+            } else {
+                for (int cc = prochaineColonne[k]; cc <= c + rayon; cc++) {
+                    const ushort *entree = &colFine[cc * 256 + k * 16];
+                    const ushort *sortante = &colFine[(cc - n) * 256 + k * 16];
+                    for (int i = 0; i < 16; i++) fin[i] += entree[i] - sortante[i];
+                }
+            }
+            prochaineColonne[k] = c + rayon + 1;
+
+            int i = 0;
+            while (cumul + fin[i] <= rang) {
+                cumul += fin[i];
+                i++;
+            }
+            sortie[x] = (uchar) (k * 16 + i);
+        }
+    }
+}
+
+/* médian de rayon donné (fenêtre (2r+1)x(2r+1)) sur une image CV_8UC1 ; medianBlur avec le backend reference */
+inline void medianConstant(const cv::Mat &input, cv::Mat &output, int rayon) {
+    CV_Assert(input.type() == CV_8UC1 && rayon >= 1);
+    MesurePerf mesure("medianConstant", (double) input.total());
+    const BackendNoyau backend = configExecution().backendMedian;
+    if (backend == BACKEND_REFERENCE) {
+        cv::medianBlur(input, output, 2 * rayon + 1);
+        return;
+    }
+
+    cv::Mat src = input;
+    if (output.data == input.data) src = input.clone();
+    output.create(src.size(), CV_8UC1);
+
+    // bandes verticales : la fenêtre de rayon r coûte 2r colonnes d'histogrammes en plus par bande
+    const int largeurBande = std::max(64, 4 * rayon);
+    const int nbBandes = (src.cols + largeurBande - 1) / largeurBande;
+    executerBandes(backend, nbBandes, [&](int b) {
+        int x0 = b * largeurBande;
+        int x1 = std::min(src.cols, x0 + largeurBande);
+        medianBandeVerticale(src, output, rayon, x0, x1);
+    });
+}
+
+#endif //TP_MEDIAN_CONSTANT_HPP
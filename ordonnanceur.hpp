@@ -0,0 +1,126 @@
+#ifndef TP_ORDONNANCEUR_HPP
+#define TP_ORDONNANCEUR_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "config_execution.hpp"
+
+/**
+ * Pool de threads à vol de tâches, partagé par tous les flux d'une exécution.
+ *
+ * Chaque thread a sa propre file : une tâche soumise depuis un thread du pool
+ * va dans sa file (traitée en dernier arrivé, premier servi, tant que ses
+ * données sont en cache), une tâche soumise de l'extérieur est répartie à
+ * tour de rôle. Un thread dont la file est vide vole la tâche la plus
+ * ancienne d'un autre thread : les cœurs restent occupés même quand les
+ * tâches n'ont pas toutes la même durée. Aucun ordre n'est garanti entre les
+ * tâches, c'est à l'appelant de remettre les résultats dans l'ordre.
+ * Avec --epingler (config_execution.hpp), le thread i reste sur le i-ème cœur
+ * autorisé : ses données restent dans le cache de ce cœur.
+ */
+class Ordonnanceur {
+public:
+    explicit Ordonnanceur(int nbThreads) {
+        nbThreads = std::max(1, nbThreads);
+        for (int i = 0; i < nbThreads; i++) {
+            files.push_back(std::unique_ptr<File>(new File()));
+        }
+        for (int i = 0; i < nbThreads; i++) {
+            threads.push_back(std::thread(&Ordonnanceur::boucle, this, i));
+        }
+    }
+
+    /* termine les tâches déjà soumises puis arrête les threads */
+    ~Ordonnanceur() {
+        {
+            std::lock_guard<std::mutex> garde(verrouSommeil);
+            arret = true;
+        }
+        reveil.notify_all();
+        for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+    }
+
+    void soumettre(const std::function<void()> &tache) {
+        int i = indiceThread();
+        if (i < 0) i = (int) (prochaine++ % files.size());
+        {
+            std::lock_guard<std::mutex> garde(files[i]->verrou);
+            files[i]->taches.push_back(tache);
+        }
+        {
+            std::lock_guard<std::mutex> garde(verrouSommeil);
+            nbEnAttente++;
+        }
+        reveil.notify_one();
+    }
+
+    int nbThreads() const {
+        return (int) threads.size();
+    }
+
+private:
+    struct File {
+        std::mutex verrou;
+        std::deque<std::function<void()>> taches;
+    };
+
+    std::vector<std::unique_ptr<File>> files;
+    std::vector<std::thread> threads;
+    std::mutex verrouSommeil;
+    std::condition_variable reveil;
+    int nbEnAttente = 0;                // protégé par verrouSommeil
+    bool arret = false;                 // protégé par verrouSommeil
+    std::atomic<unsigned> prochaine{0};
+
+    /* indice du thread du pool qui exécute l'appel, -1 hors du pool */
+    static int &indiceThread() {
+        static thread_local int indice = -1;
+        return indice;
+    }
+
+    bool prendre(int i, std::function<void()> &tache) {
+        const int n = (int) files.size();
+        for (int k = 0; k < n; k++) {
+            File &file = *files[(i + k) % n];
+            std::lock_guard<std::mutex> garde(file.verrou);
+            if (file.taches.empty()) continue;
+            if (k == 0) {
+                // sa propre file : la tâche la plus récente
+                tache = std::move(file.taches.back());
+                file.taches.pop_back();
+            } else {
+                // vol : la tâche la plus ancienne
+                tache = std::move(file.taches.front());
+                file.taches.pop_front();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void boucle(int i) {
+        indiceThread() = i;
+        epinglerThread(i);
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> verrou(verrouSommeil);
+                reveil.wait(verrou, [this]() { return nbEnAttente > 0 || arret; });
+                if (nbEnAttente == 0) return;   // arrêt, plus rien à faire
+                nbEnAttente--;
+            }
+            // une tâche est réservée : elle est dans l'une des files
+            std::function<void()> tache;
+            while (!prendre(i, tache)) std::this_thread::yield();
+            tache();
+        }
+    }
+};
+
+#endif //TP_ORDONNANCEUR_HPP
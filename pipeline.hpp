@@ -0,0 +1,297 @@
+#ifndef TP_PIPELINE_HPP
+#define TP_PIPELINE_HPP
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "compteurs_perf.hpp"
+#include "pool_tampons.hpp"
+
+/**
+ * Chaîne de traitements décrite par une liste de noms ("a,s,g,t", "egal,tram").
+ *
+ * Les étapes sont de quatre sortes :
+ *  - ponctuelle : table 256 entrées (seuil, négatif...). Les tables successives
+ *    sont composées et appliquées en une seule passe, en même temps que la
+ *    lecture de l'étape suivante.
+ *  - histogramme : table calculée à partir de l'histogramme de l'image à ce
+ *    point de la chaîne (égalisation). L'histogramme est obtenu en relisant
+ *    la dernière image matérialisée au travers des tables en attente.
+ *  - voisinage : filtre de rayon connu. Les étapes de voisinage consécutives
+ *    sont enchaînées bande par bande (avec un halo égal à la somme des rayons)
+ *    pour que les intermédiaires restent en cache.
+ *  - globale : traitement de l'image entière (tramage...).
+ *
+ * Toutes les images de la chaîne sont en CV_8UC1 et les tampons intermédiaires
+ * sont pris dans des PoolTampons conservés d'un appel à l'autre.
+ */
+
+enum TypeEtape {
+    ETAPE_PONCTUELLE,
+    ETAPE_HISTOGRAMME,
+    ETAPE_VOISINAGE,
+    ETAPE_GLOBALE
+};
+
+struct Etape {
+    cv::String nom;
+    TypeEtape type = ETAPE_GLOBALE;
+    cv::Mat lut;                                                                // ponctuelle
+    std::function<cv::Mat(const std::vector<double> &)> lutDepuisHistogramme;   // histogramme
+    int rayon = 0;                                                              // voisinage
+    std::function<void(const cv::Mat &, cv::Mat &)> appliquer;                  // voisinage, globale
+    std::function<void(const cv::Mat &, cv::Mat &, cv::Mat &, PoolTampons &)> appliquerBande;  // globale, en flux
+};
+
+typedef std::map<cv::String, Etape> CatalogueEtapes;
+
+inline Etape etapePonctuelle(const cv::String &nom, const cv::Mat &lut) {
+    Etape etape;
+    etape.nom = nom;
+    etape.type = ETAPE_PONCTUELLE;
+    etape.lut = lut;
+    return etape;
+}
+
+inline Etape etapeHistogramme(const cv::String &nom,
+                              const std::function<cv::Mat(const std::vector<double> &)> &lutDepuisHistogramme) {
+    Etape etape;
+    etape.nom = nom;
+    etape.type = ETAPE_HISTOGRAMME;
+    etape.lutDepuisHistogramme = lutDepuisHistogramme;
+    return etape;
+}
+
+inline Etape etapeVoisinage(const cv::String &nom, int rayon,
+                            const std::function<void(const cv::Mat &, cv::Mat &)> &appliquer) {
+    Etape etape;
+    etape.nom = nom;
+    etape.type = ETAPE_VOISINAGE;
+    etape.rayon = rayon;
+    etape.appliquer = appliquer;
+    return etape;
+}
+
+inline Etape etapeGlobale(const cv::String &nom, const std::function<void(const cv::Mat &, cv::Mat &)> &appliquer) {
+    Etape etape;
+    etape.nom = nom;
+    etape.type = ETAPE_GLOBALE;
+    etape.appliquer = appliquer;
+    return etape;
+}
+
+/**
+ * Globale qui sait aussi traiter l'image par bandes successives en reportant
+ * un état d'une bande à l'autre ; ses tampons de travail viennent de la
+ * réserve de l'étage (pool).
+ */
+inline Etape etapeGlobale(const cv::String &nom, const std::function<void(const cv::Mat &, cv::Mat &)> &appliquer,
+                          const std::function<void(const cv::Mat &, cv::Mat &, cv::Mat &, PoolTampons &)>
+                          &appliquerBande) {
+    Etape etape = etapeGlobale(nom, appliquer);
+    etape.appliquerBande = appliquerBande;
+    return etape;
+}
+
+/* découpe "a,s,g,t" en étapes du catalogue, faux si un nom est inconnu */
+inline bool analyserPipeline(const cv::String &description, const CatalogueEtapes &catalogue,
+                             std::vector<Etape> &etapes) {
+    etapes.clear();
+    std::stringstream flux(description);
+    std::string nom;
+    while (std::getline(flux, nom, ',')) {
+        auto it = catalogue.find(nom);
+        if (it == catalogue.end()) {
+            std::cout << "Etape inconnue : " << nom << std::endl;
+            return false;
+        }
+        etapes.push_back(it->second);
+    }
+    return !etapes.empty();
+}
+
+inline cv::Mat lutIdentite() {
+    cv::Mat lut(1, 256, CV_8UC1);
+    for (int i = 0; i < 256; i++) lut.at<uchar>(i) = (uchar) i;
+    return lut;
+}
+
+/* histogramme normalisé de lut(image), sans matérialiser lut(image) */
+inline std::vector<double> histogrammeApresLut(const cv::Mat &image, const cv::Mat &lut) {
+    std::vector<int> compte(256, 0);
+    for (int i = 0; i < image.rows; i++) {
+        const uchar *ligne = image.ptr<uchar>(i);
+        for (int j = 0; j < image.cols; j++) {
+            compte[ligne[j]]++;
+        }
+    }
+
+    std::vector<double> histogramme(256, 0.0);
+    const uchar *table = lut.ptr<uchar>();
+    for (int v = 0; v < 256; v++) {
+        histogramme[table[v]] += compte[v];
+    }
+    for (int v = 0; v < 256; v++) {
+        histogramme[v] = histogramme[v] / (image.rows * image.cols);
+    }
+    return histogramme;
+}
+
+/**
+ * Applique les étapes de voisinage [debut, fin) à une bande (halo compris),
+ * lut (si non vide) étant appliquée à la lecture. Le résultat est une vue sur
+ * un tampon de pool, à lui rendre une fois les lignes utiles recopiées.
+ */
+inline cv::Mat appliquerVoisinageBande(const std::vector<Etape> &etapes, size_t debut, size_t fin,
+                                       const cv::Mat &entreeBande, const cv::Mat &lut, PoolTampons &pool) {
+    cv::Mat courantBande = entreeBande;
+    if (!lut.empty()) {
+        cv::Mat tamponLut = pool.obtenir(entreeBande.rows, entreeBande.cols, CV_8UC1);
+        cv::LUT(entreeBande, lut, tamponLut);
+        courantBande = tamponLut;
+    }
+
+    for (size_t k = debut; k < fin; k++) {
+        cv::Mat tampon = pool.obtenir(entreeBande.rows, entreeBande.cols, CV_8UC1);
+        cv::Mat resultat = tampon;
+        etapes[k].appliquer(courantBande, resultat);
+        if (resultat.type() != CV_8UC1) resultat.convertTo(resultat, CV_8UC1);
+
+        if (resultat.data != tampon.data) pool.rendre(tampon);
+        if (pool.contient(courantBande)) pool.rendre(courantBande);
+        courantBande = resultat;
+    }
+    return courantBande;
+}
+
+class MoteurPipeline {
+public:
+    /* tailleCache : budget (en octets) des bandes d'une suite d'étapes de voisinage */
+    explicit MoteurPipeline(size_t tailleCache = 256 * 1024) : tailleCache(tailleCache) {}
+
+    void executer(const std::vector<Etape> &etapes, const cv::Mat &entree, cv::Mat &sortie) {
+        CV_Assert(entree.type() == CV_8UC1);
+
+        cv::Mat courant = entree;
+        cv::Mat lut = lutIdentite();
+        bool lutEnAttente = false;
+
+        size_t i = 0;
+        while (i < etapes.size()) {
+            const Etape &etape = etapes[i];
+
+            if (etape.type == ETAPE_PONCTUELLE) {
+                cv::LUT(lut, etape.lut, lut);
+                lutEnAttente = true;
+                i++;
+                continue;
+            }
+
+            if (etape.type == ETAPE_HISTOGRAMME) {
+                MesurePerf mesure(etape.nom.c_str(), (double) entree.total());
+                cv::LUT(lut, etape.lutDepuisHistogramme(histogrammeApresLut(courant, lut)), lut);
+                lutEnAttente = true;
+                i++;
+                continue;
+            }
+
+            // suite d'étapes de voisinage consécutives, ou une étape globale
+            size_t fin = i + 1;
+            if (etape.type == ETAPE_VOISINAGE) {
+                while (fin < etapes.size() && etapes[fin].type == ETAPE_VOISINAGE) fin++;
+            }
+
+            // avec les compteurs matériels, une mesure par suite d'étapes (ex. "a+s+g")
+            std::string nomMesure;
+            if (compteursPerfActifs()) {
+                for (size_t k = i; k < fin; k++) nomMesure += (k > i ? "+" : "") + std::string(etapes[k].nom);
+            }
+            MesurePerf mesure(nomMesure.c_str(), (double) entree.total());
+
+            // la dernière étape écrit directement dans la sortie quand c'est possible
+            bool dansSortie = (fin == etapes.size()) && sortie.data != courant.data && sortie.data != entree.data;
+            cv::Mat tampon = dansSortie ? cv::Mat() : pool.obtenir(entree.rows, entree.cols, CV_8UC1);
+            cv::Mat destination = dansSortie ? sortie : tampon;
+
+            if (etape.type == ETAPE_VOISINAGE) {
+                executerVoisinage(etapes, i, fin, courant, lutEnAttente ? lut : cv::Mat(), destination);
+            } else {
+                cv::Mat source = courant;
+                if (lutEnAttente) {
+                    source = pool.obtenir(entree.rows, entree.cols, CV_8UC1);
+                    cv::LUT(courant, lut, source);
+                }
+                etape.appliquer(source, destination);
+                if (destination.type() != CV_8UC1) destination.convertTo(destination, CV_8UC1);
+                if (pool.contient(source)) pool.rendre(source);
+            }
+
+            if (dansSortie) sortie = destination;
+            if (!tampon.empty() && destination.data != tampon.data) pool.rendre(tampon);
+            if (pool.contient(courant)) pool.rendre(courant);
+
+            courant = destination;
+            lut = lutIdentite();
+            lutEnAttente = false;
+            i = fin;
+        }
+
+        if (lutEnAttente) {
+            cv::LUT(courant, lut, sortie);
+        } else if (courant.data != sortie.data) {
+            courant.copyTo(sortie);
+        }
+        if (pool.contient(courant)) pool.rendre(courant);
+    }
+
+private:
+    size_t tailleCache;
+    PoolTampons pool;                       // images entières entre deux suites d'étapes
+    std::vector<PoolTampons> poolsBandes;   // un par bloc de bandes traité en parallèle
+
+    /* étapes [debut, fin) de voisinage, bande par bande ; lut (si non vide) appliquée à la lecture */
+    void executerVoisinage(const std::vector<Etape> &etapes, size_t debut, size_t fin,
+                           const cv::Mat &source, const cv::Mat &lut, cv::Mat &destination) {
+        const int rows = source.rows;
+        const int cols = source.cols;
+        destination.create(rows, cols, CV_8UC1);
+
+        int halo = 0;
+        for (size_t k = debut; k < fin; k++) halo += etapes[k].rayon;
+
+        const int nbTampons = (int) (fin - debut) + 1;
+        const int hauteur = std::max(8, (int) (tailleCache / ((size_t) cols * nbTampons)) - 2 * halo);
+        const int nbBandes = (rows + hauteur - 1) / hauteur;
+        const int nbBlocs = std::max(1, std::min(nbBandes, cv::getNumThreads()));
+        if ((int) poolsBandes.size() < nbBlocs) poolsBandes.resize(nbBlocs);
+
+        cv::parallel_for_(cv::Range(0, nbBlocs), [&](const cv::Range &plage) {
+            // les noyaux des bandes comptent dans la mesure de la suite d'étapes, pas séparément
+            BandesSansMesure sansMesure;
+            for (int b = plage.start; b < plage.end; b++) {
+                PoolTampons &poolBloc = poolsBandes[b];
+
+                for (int bande = b * nbBandes / nbBlocs; bande < (b + 1) * nbBandes / nbBlocs; bande++) {
+                    const int y0 = bande * hauteur;
+                    const int y1 = std::min(rows, y0 + hauteur);
+                    const int haut = std::max(0, y0 - halo);
+                    const int bas = std::min(rows, y1 + halo);
+
+                    cv::Mat courantBande = appliquerVoisinageBande(etapes, debut, fin, source.rowRange(haut, bas),
+                                                                   lut, poolBloc);
+
+                    // seules les lignes [y0, y1) sont valides, le halo est abandonné
+                    courantBande.rowRange(y0 - haut, y1 - haut).copyTo(destination.rowRange(y0, y1));
+                    if (poolBloc.contient(courantBande)) poolBloc.rendre(courantBande);
+                }
+            }
+        });
+    }
+};
+
+#endif //TP_PIPELINE_HPP
@@ -0,0 +1,314 @@
+#ifndef TP_PIPELINE_FLUX_HPP
+#define TP_PIPELINE_FLUX_HPP
+
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "flux_pnm.hpp"
+#include "pipeline.hpp"
+
+/**
+ * Exécution d'une chaîne sur une image plus grande que la mémoire.
+ *
+ * L'image est lue par bandes de lignes depuis le disque et chaque bande
+ * traverse une suite d'étages qui rendent leurs lignes dans l'ordre :
+ *  - table : les étapes ponctuelles composées ;
+ *  - voisinage : garde le halo de lignes nécessaire aux étapes de voisinage
+ *    consécutives et traite plusieurs bandes à la fois en parallèle ;
+ *  - séquentiel : étape globale capable de travailler par bandes en
+ *    reportant un état (erreur de diffusion du tramage) ;
+ *  - écriture : la sortie est écrite au fur et à mesure.
+ * La mémoire utilisée est de l'ordre de (hauteur de bande + 2 x halo) x
+ * nombre de threads lignes par étage, quelle que soit la taille de l'image.
+ */
+
+class EtageFlux {
+public:
+    virtual ~EtageFlux() {}
+
+    /* lignes suivantes du flux */
+    virtual void pousser(const cv::Mat &lignes) = 0;
+
+    /* fin de l'image */
+    virtual void terminer() {
+        if (suivant != nullptr) suivant->terminer();
+    }
+
+    EtageFlux *suivant = nullptr;
+};
+
+class EtageEcriture : public EtageFlux {
+public:
+    explicit EtageEcriture(EcrivainPGM &ecrivain) : ecrivain(ecrivain) {}
+
+    /* un échec d'écriture est gardé par l'écrivain : executerEnFlux arrête alors la lecture */
+    void pousser(const cv::Mat &lignes) override {
+        ecrivain.ecrire(lignes);
+    }
+
+private:
+    EcrivainPGM &ecrivain;
+};
+
+class EtageTable : public EtageFlux {
+public:
+    explicit EtageTable(const cv::Mat &lut) : lut(lut) {}
+
+    void pousser(const cv::Mat &lignes) override {
+        cv::LUT(lignes, lut, sortie);
+        suivant->pousser(sortie);
+    }
+
+private:
+    cv::Mat lut;
+    cv::Mat sortie;
+};
+
+class EtageSequentiel : public EtageFlux {
+public:
+    explicit EtageSequentiel(const Etape &etape) : etape(etape) {}
+
+    void pousser(const cv::Mat &lignes) override {
+        etape.appliquerBande(lignes, sortie, etat, pool);
+        if (sortie.type() != CV_8UC1) sortie.convertTo(sortie, CV_8UC1);
+        suivant->pousser(sortie);
+    }
+
+private:
+    Etape etape;
+    cv::Mat sortie;
+    cv::Mat etat;
+    PoolTampons pool;                   // tampons de travail d'une bande
+};
+
+class EtageVoisinage : public EtageFlux {
+public:
+    EtageVoisinage(const std::vector<Etape> &etapes, int hauteurBande, int nbBandesParallele)
+            : etapes(etapes), hauteurBande(hauteurBande), nbBandesParallele(nbBandesParallele),
+              pools(nbBandesParallele) {
+        for (size_t k = 0; k < etapes.size(); k++) {
+            halo += etapes[k].rayon;
+            nomMesure += (k > 0 ? "+" : "") + std::string(etapes[k].nom);
+        }
+    }
+
+    void pousser(const cv::Mat &lignes) override {
+        ajouter(lignes);
+
+        // un paquet de bandes est prêt dès que le halo sous sa dernière ligne est arrivé
+        const int paquet = hauteurBande * nbBandesParallele;
+        while (premiereLigne + nbLignes >= prochaineSortie + paquet + halo) {
+            traiter(paquet);
+        }
+    }
+
+    void terminer() override {
+        const int paquet = hauteurBande * nbBandesParallele;
+        while (premiereLigne + nbLignes > prochaineSortie) {
+            traiter(std::min(paquet, premiereLigne + nbLignes - prochaineSortie));
+        }
+        EtageFlux::terminer();
+    }
+
+private:
+    std::vector<Etape> etapes;
+    int hauteurBande;
+    int nbBandesParallele;
+    int halo = 0;
+    std::vector<PoolTampons> pools;     // un par bande d'un paquet
+    std::string nomMesure;              // suite d'étapes, pour les compteurs matériels
+
+    cv::Mat fenetre;                    // lignes [premiereLigne, premiereLigne + nbLignes) de l'entrée
+    int premiereLigne = 0;
+    int nbLignes = 0;
+    int prochaineSortie = 0;
+    cv::Mat sortie;
+
+    void ajouter(const cv::Mat &lignes) {
+        if (fenetre.empty() || nbLignes + lignes.rows > fenetre.rows) {
+            int capacite = std::max(nbLignes + lignes.rows, 2 * halo + hauteurBande * nbBandesParallele + lignes.rows);
+            cv::Mat agrandie(capacite, lignes.cols, CV_8UC1);
+            if (nbLignes > 0) fenetre.rowRange(0, nbLignes).copyTo(agrandie.rowRange(0, nbLignes));
+            fenetre = agrandie;
+        }
+        lignes.copyTo(fenetre.rowRange(nbLignes, nbLignes + lignes.rows));
+        nbLignes += lignes.rows;
+    }
+
+    /* produit les n lignes suivantes, réparties en bandes traitées en parallèle */
+    void traiter(int n) {
+        const int debut = prochaineSortie;
+        const int finDisponible = premiereLigne + nbLignes;
+        const int nbBandes = (n + hauteurBande - 1) / hauteurBande;
+        sortie.create(n, fenetre.cols, CV_8UC1);
+
+        {
+            // mesure limitée aux bandes : l'étage suivant (pousser) a la sienne
+            MesurePerf mesure(nomMesure.c_str(), (double) n * fenetre.cols);
+            cv::parallel_for_(cv::Range(0, nbBandes), [&](const cv::Range &plage) {
+                BandesSansMesure sansMesure;
+                for (int b = plage.start; b < plage.end; b++) {
+                    const int y0 = debut + b * hauteurBande;
+                    const int y1 = std::min(debut + n, y0 + hauteurBande);
+                    const int haut = std::max(premiereLigne, y0 - halo);
+                    const int bas = std::min(finDisponible, y1 + halo);
+
+                    cv::Mat entree = fenetre.rowRange(haut - premiereLigne, bas - premiereLigne);
+                    cv::Mat resultat = appliquerVoisinageBande(etapes, 0, etapes.size(), entree, cv::Mat(),
+                                                               pools[b]);
+                    resultat.rowRange(y0 - haut, y1 - haut).copyTo(sortie.rowRange(y0 - debut, y1 - debut));
+                    if (pools[b].contient(resultat)) pools[b].rendre(resultat);
+                }
+            });
+        }
+
+        prochaineSortie += n;
+        suivant->pousser(sortie);
+
+        // ne garder que le halo au-dessus de la prochaine ligne à produire
+        const int decalage = std::max(0, prochaineSortie - halo - premiereLigne);
+        for (int i = decalage; i < nbLignes; i++) {
+            std::memmove(fenetre.ptr(i - decalage), fenetre.ptr(i), fenetre.cols);
+        }
+        nbLignes -= decalage;
+        premiereLigne += decalage;
+    }
+};
+
+/**
+ * Exécute la chaîne de lecteur vers ecrivain par bandes de hauteurBande lignes.
+ * L'égalisation n'est acceptée qu'en tête de chaîne (après des étapes
+ * ponctuelles) : son histogramme est calculé par une première lecture du
+ * fichier. Les étapes globales doivent savoir travailler par bandes. La
+ * lecture s'arrête au premier échec d'écriture, que ecrivain.fermer() signale.
+ * Faux si l'entrée est plus courte que son en-tête : la sortie est incomplète.
+ */
+inline bool executerEnFlux(const std::vector<Etape> &etapes, LecteurPNM &lecteur, EcrivainPGM &ecrivain,
+                           int hauteurBande) {
+    std::vector<std::unique_ptr<EtageFlux>> etages;
+    cv::Mat lut = lutIdentite();
+    bool lutEnAttente = false;
+    bool enTete = true;
+    const int nbBandesParallele = std::max(1, cv::getNumThreads());
+
+    size_t i = 0;
+    while (i < etapes.size()) {
+        const Etape &etape = etapes[i];
+
+        if (etape.type == ETAPE_PONCTUELLE) {
+            cv::LUT(lut, etape.lut, lut);
+            lutEnAttente = true;
+            i++;
+        } else if (etape.type == ETAPE_HISTOGRAMME) {
+            if (!enTete) {
+                std::cout << etape.nom << " : uniquement en tête de chaîne en mode tuiles" << std::endl;
+                return false;
+            }
+
+            // première lecture : histogramme de l'image vue au travers des tables
+            std::vector<double> compte(256, 0.0);
+            cv::Mat bande;
+            while (lecteur.lire(hauteurBande, bande)) {
+                for (int y = 0; y < bande.rows; y++) {
+                    const uchar *ligne = bande.ptr<uchar>(y);
+                    for (int x = 0; x < bande.cols; x++) compte[ligne[x]]++;
+                }
+            }
+            if (!lecteur.complet()) {
+                std::cout << "Fichier d'entrée tronqué" << std::endl;
+                return false;
+            }
+            lecteur.rembobiner();
+
+            std::vector<double> histogramme(256, 0.0);
+            const uchar *table = lut.ptr<uchar>();
+            for (int v = 0; v < 256; v++) histogramme[table[v]] += compte[v];
+            for (int v = 0; v < 256; v++) histogramme[v] /= (double) lecteur.largeur * lecteur.hauteur;
+
+            cv::LUT(lut, etape.lutDepuisHistogramme(histogramme), lut);
+            lutEnAttente = true;
+            i++;
+        } else {
+            enTete = false;
+            if (lutEnAttente) {
+                etages.push_back(std::unique_ptr<EtageFlux>(new EtageTable(lut)));
+                lut = lutIdentite();
+                lutEnAttente = false;
+            }
+
+            if (etape.type == ETAPE_VOISINAGE) {
+                size_t fin = i + 1;
+                while (fin < etapes.size() && etapes[fin].type == ETAPE_VOISINAGE) fin++;
+                std::vector<Etape> suite(etapes.begin() + i, etapes.begin() + fin);
+                etages.push_back(std::unique_ptr<EtageFlux>(
+                        new EtageVoisinage(suite, hauteurBande, nbBandesParallele)));
+                i = fin;
+            } else {
+                if (!etape.appliquerBande) {
+                    std::cout << etape.nom << " : non disponible en mode tuiles" << std::endl;
+                    return false;
+                }
+                etages.push_back(std::unique_ptr<EtageFlux>(new EtageSequentiel(etape)));
+                i++;
+            }
+        }
+    }
+    if (lutEnAttente) {
+        etages.push_back(std::unique_ptr<EtageFlux>(new EtageTable(lut)));
+    }
+    etages.push_back(std::unique_ptr<EtageFlux>(new EtageEcriture(ecrivain)));
+
+    for (size_t k = 0; k + 1 < etages.size(); k++) {
+        etages[k]->suivant = etages[k + 1].get();
+    }
+
+    cv::Mat bande;
+    while (ecrivain.valide() && lecteur.lire(hauteurBande, bande)) {
+        etages[0]->pousser(bande);
+    }
+    if (!ecrivain.valide()) return true;
+    if (!lecteur.complet()) {
+        std::cout << "Fichier d'entrée tronqué" << std::endl;
+        return false;
+    }
+    etages[0]->terminer();
+    return true;
+}
+
+/* mode tuiles des exécutables : entree (PGM / PPM) -> sortie (PGM) */
+inline bool executerTuiles(const std::string &entree, const std::string &sortie, const cv::String &chaine,
+                           const CatalogueEtapes &catalogue, int hauteurBande) {
+    std::vector<Etape> etapes;
+    if (!analyserPipeline(chaine, catalogue, etapes)) return false;
+
+    LecteurPNM lecteur;
+    if (!lecteur.ouvrir(entree)) {
+        std::cout << "Impossible de lire " << entree << std::endl;
+        return false;
+    }
+    EcrivainPGM ecrivain;
+    if (!ecrivain.ouvrir(sortie, lecteur.largeur, lecteur.hauteur)) {
+        std::cout << "Impossible d'écrire " << sortie << std::endl;
+        return false;
+    }
+
+    int64 debut = cv::getTickCount();
+    bool ok = executerEnFlux(etapes, lecteur, ecrivain, hauteurBande);
+    if (!ecrivain.fermer()) {
+        // disque plein ou erreur d'entrée-sortie
+        std::cout << "Écriture de " << sortie << " incomplète" << std::endl;
+        ok = false;
+    }
+    if (!ok) std::remove(sortie.c_str());       // pas de sortie tronquée
+    double duree = (cv::getTickCount() - debut) / cv::getTickFrequency();
+    if (ok) {
+        std::cout << chaine << " sur " << lecteur.largeur << "x" << lecteur.hauteur << " par bandes de "
+                  << hauteurBande << " lignes : " << duree << " s" << std::endl;
+    }
+    return ok;
+}
+
+#endif //TP_PIPELINE_FLUX_HPP
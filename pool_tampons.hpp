@@ -0,0 +1,64 @@
+#ifndef TP_POOL_TAMPONS_HPP
+#define TP_POOL_TAMPONS_HPP
+
+#include <algorithm>
+#include <vector>
+#include "opencv2/core.hpp"
+
+/**
+ * Réserve de tampons réutilisables.
+ *
+ * obtenir() rend une Mat de la taille demandée construite sur un tampon déjà
+ * alloué quand il y en a un assez grand, rendre() le remet à disposition.
+ * Les tampons sont alloués par OpenCV (alignés sur 64 octets) et ne sont
+ * libérés qu'à la destruction de la réserve.
+ */
+class PoolTampons {
+public:
+    cv::Mat obtenir(int rows, int cols, int type) {
+        size_t taille = (size_t) rows * cols * CV_ELEM_SIZE(type);
+
+        // plus petit tampon libre suffisant
+        int choisi = -1;
+        for (int i = 0; i < (int) libres.size(); i++) {
+            size_t capacite = libres[i].total();
+            if (capacite >= taille && (choisi < 0 || capacite < libres[choisi].total())) {
+                choisi = i;
+            }
+        }
+
+        cv::Mat tampon;
+        if (choisi >= 0) {
+            tampon = libres[choisi];
+            libres.erase(libres.begin() + choisi);
+        } else {
+            tampon.create(1, (int) std::max(taille, (size_t) 1), CV_8UC1);
+        }
+        utilises.push_back(tampon);
+        return cv::Mat(rows, cols, type, tampon.data);
+    }
+
+    void rendre(const cv::Mat &vue) {
+        for (size_t i = 0; i < utilises.size(); i++) {
+            if (utilises[i].data == vue.data) {
+                libres.push_back(utilises[i]);
+                utilises.erase(utilises.begin() + i);
+                return;
+            }
+        }
+    }
+
+    /* vrai si la Mat est une vue sur un tampon de la réserve */
+    bool contient(const cv::Mat &vue) const {
+        for (size_t i = 0; i < utilises.size(); i++) {
+            if (utilises[i].data == vue.data) return true;
+        }
+        return false;
+    }
+
+private:
+    std::vector<cv::Mat> libres;
+    std::vector<cv::Mat> utilises;
+};
+
+#endif //TP_POOL_TAMPONS_HPP
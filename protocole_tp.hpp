@@ -0,0 +1,279 @@
+#ifndef TP_PROTOCOLE_TP_HPP
+#define TP_PROTOCOLE_TP_HPP
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "opencv2/core.hpp"
+
+/**
+ * Protocole entre le serveur de traitements (serveur_tp) et ses clients
+ * (client_tp, charge_tp) sur une socket Unix locale.
+ *
+ * Une connexion envoie des RequeteTP et reçoit une ReponseTP pour chacune,
+ * dans l'ordre. L'image d'entrée est un fichier lu (et gardé) par le serveur,
+ * ou un segment de mémoire partagée rempli par le client. Le résultat (lignes
+ * contiguës, même nombre de canaux que l'entrée) est écrit par le serveur dans
+ * un segment de mémoire partagée propre à la connexion, réutilisé d'une
+ * requête à l'autre : aucun pixel ne passe par la socket.
+ *
+ * canaux choisit les étapes : 1, celles de main_grey_img et main_tp2 sur
+ * l'image en niveaux de gris (CV_8UC1) ; 3, celles de main_color_img sur
+ * l'image en BGR (CV_8UC3).
+ */
+
+#define TP_MAGIQUE 0x54503032          // "TP02"
+
+enum SourceRequete {
+    SOURCE_FICHIER = 0,     // chemin : fichier image
+    SOURCE_MEMOIRE = 1      // chemin : nom du segment, rows x cols x canaux octets
+};
+
+struct RequeteTP {
+    uint32_t magique = TP_MAGIQUE;
+    int32_t source = SOURCE_FICHIER;
+    int32_t rows = 0;
+    int32_t cols = 0;
+    int32_t canaux = 1;         // 1 : niveaux de gris, 3 : BGR
+    int32_t alpha = 20;         // paramètres des étapes (valeurs par défaut des trackbars)
+    int32_t seuil = 20;
+    int32_t rayon = 1;
+    int32_t proportion = 50;
+    int32_t longueur = 100;
+    char chemin[PATH_MAX] = {0};
+    char chaine[256] = {0};
+};
+
+struct ReponseTP {
+    int32_t statut = 0;         // 0 : succès
+    int32_t rows = 0;
+    int32_t cols = 0;
+    int32_t canaux = 0;
+    double dureeMs = 0.0;       // temps de traitement côté serveur
+    char segment[64] = {0};     // segment du résultat
+    char message[256] = {0};
+};
+
+/** --- SOCKET --- **/
+/* $XDG_RUNTIME_DIR/tp_info001.sock (répertoire propre à l'utilisateur), sinon /tmp/tp_info001.sock */
+inline std::string cheminSocketDefaut() {
+    const char *repertoire = getenv("XDG_RUNTIME_DIR");
+    if (repertoire != nullptr && repertoire[0] != 0) return std::string(repertoire) + "/tp_info001.sock";
+    return "/tmp/tp_info001.sock";
+}
+
+inline bool envoyerTout(int fd, const void *donnees, size_t taille) {
+    const char *p = (const char *) donnees;
+    while (taille > 0) {
+        ssize_t n = send(fd, p, taille, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        p += n;
+        taille -= n;
+    }
+    return true;
+}
+
+inline bool recevoirTout(int fd, void *donnees, size_t taille) {
+    char *p = (char *) donnees;
+    while (taille > 0) {
+        ssize_t n = recv(fd, p, taille, 0);
+        if (n <= 0) return false;
+        p += n;
+        taille -= n;
+    }
+    return true;
+}
+
+inline bool adresseSocket(const std::string &chemin, sockaddr_un &adresse) {
+    if (chemin.size() >= sizeof(adresse.sun_path)) return false;
+    memset(&adresse, 0, sizeof(adresse));
+    adresse.sun_family = AF_UNIX;
+    strcpy(adresse.sun_path, chemin.c_str());
+    return true;
+}
+
+/* -1 si le serveur ne répond pas */
+inline int connecterServeur(const std::string &chemin) {
+    sockaddr_un adresse;
+    if (!adresseSocket(chemin, adresse)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (sockaddr *) &adresse, sizeof(adresse)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/** --- MEMOIRE PARTAGEE --- **/
+/* segment POSIX (shm_open) projeté en mémoire ; le créateur le supprime à la destruction */
+class SegmentPartage {
+public:
+    ~SegmentPartage() {
+        fermer();
+    }
+
+    /* crée (ou agrandit) le segment pour qu'il contienne au moins taille octets */
+    bool creer(const std::string &nomSegment, size_t tailleMin) {
+        if (proprietaire && nomSegment == nom && tailleMin <= taille) return true;
+        fermer();
+        int fd = shm_open(nomSegment.c_str(), O_CREAT | O_RDWR, 0600);
+        if (fd < 0) return false;
+        bool ok = ftruncate(fd, (off_t) tailleMin) == 0 && projeter(fd, tailleMin, true);
+        close(fd);
+        if (!ok) {
+            shm_unlink(nomSegment.c_str());
+            return false;
+        }
+        nom = nomSegment;
+        proprietaire = true;
+        return true;
+    }
+
+    /**
+     * Projette au moins taille octets d'un segment créé par l'autre processus.
+     * Faux si le segment est plus petit : lire au-delà de sa fin tuerait le
+     * processus (SIGBUS). La taille est revérifiée à chaque appel, l'autre
+     * processus ayant pu tronquer le segment depuis.
+     */
+    bool ouvrir(const std::string &nomSegment, size_t tailleMin, bool ecriture) {
+        int fd = shm_open(nomSegment.c_str(), ecriture ? O_RDWR : O_RDONLY, 0);
+        if (fd < 0) {
+            fermer();
+            return false;
+        }
+        struct stat infos;
+        if (fstat(fd, &infos) != 0 || (size_t) infos.st_size < tailleMin) {
+            close(fd);
+            fermer();
+            return false;
+        }
+        if (!proprietaire && nomSegment == nom && tailleMin <= taille) {
+            close(fd);
+            return true;
+        }
+        fermer();
+        bool ok = projeter(fd, tailleMin, ecriture);
+        close(fd);
+        if (ok) nom = nomSegment;
+        return ok;
+    }
+
+    void fermer() {
+        if (donnees != nullptr) munmap(donnees, taille);
+        if (proprietaire) shm_unlink(nom.c_str());
+        donnees = nullptr;
+        taille = 0;
+        nom.clear();
+        proprietaire = false;
+    }
+
+    /* vue CV_8UC(canaux) sur le début du segment, sans copie */
+    cv::Mat image(int rows, int cols, int canaux = 1) const {
+        return cv::Mat(rows, cols, CV_8UC(canaux), donnees);
+    }
+
+    const std::string &nomSegment() const {
+        return nom;
+    }
+
+private:
+    void *donnees = nullptr;
+    size_t taille = 0;
+    std::string nom;
+    bool proprietaire = false;
+
+    bool projeter(int fd, size_t tailleMin, bool ecriture) {
+        int protection = ecriture ? (PROT_READ | PROT_WRITE) : PROT_READ;
+        void *p = mmap(nullptr, std::max<size_t>(tailleMin, 1), protection, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) return false;
+        donnees = p;
+        taille = std::max<size_t>(tailleMin, 1);
+        return true;
+    }
+};
+
+/** --- CLIENT --- **/
+/* options communes à client_tp et charge_tp (--socket, --memoire, --couleur, --params), faux si inconnue */
+inline bool lireOptionClient(int argc, char *argv[], int &i, RequeteTP &requete, std::string &cheminSocket,
+                             bool &memoire) {
+    std::string option = argv[i];
+    if (option == "--socket" && i + 1 < argc) {
+        cheminSocket = argv[++i];
+    } else if (option == "--memoire") {
+        memoire = true;
+    } else if (option == "--couleur") {
+        requete.canaux = 3;
+    } else if (option == "--params" && i + 1 < argc) {
+        return sscanf(argv[++i], "%d,%d,%d,%d,%d", &requete.alpha, &requete.seuil, &requete.rayon,
+                      &requete.proportion, &requete.longueur) == 5;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/* connexion au serveur ; le résultat de traiter() est une vue valable jusqu'à la requête suivante */
+class ClientTP {
+public:
+    ~ClientTP() {
+        if (fd >= 0) close(fd);
+    }
+
+    bool connecter(const std::string &cheminSocket) {
+        fd = connecterServeur(cheminSocket);
+        return fd >= 0;
+    }
+
+    /* copie image (CV_8UC1 ou CV_8UC3) dans le segment d'entrée du client et y fait pointer requete */
+    bool preparerEntree(const cv::Mat &image, RequeteTP &requete) {
+        CV_Assert(image.type() == CV_8UC1 || image.type() == CV_8UC3);
+        std::string nom = "/tp_entree_" + std::to_string(getpid()) + "_" + std::to_string(fd);
+        if (!entree.creer(nom, image.total() * image.elemSize())) return false;
+        cv::Mat vue = entree.image(image.rows, image.cols, image.channels());
+        image.copyTo(vue);
+
+        requete.source = SOURCE_MEMOIRE;
+        requete.rows = image.rows;
+        requete.cols = image.cols;
+        requete.canaux = image.channels();
+        snprintf(requete.chemin, sizeof(requete.chemin), "%s", nom.c_str());
+        return true;
+    }
+
+    bool traiter(const RequeteTP &requete, ReponseTP &reponse, cv::Mat &resultat) {
+        if (!envoyerTout(fd, &requete, sizeof(requete)) || !recevoirTout(fd, &reponse, sizeof(reponse))) {
+            snprintf(reponse.message, sizeof(reponse.message), "connexion au serveur perdue");
+            return false;
+        }
+        if (reponse.statut != 0) return false;
+        if (reponse.canaux != 1 && reponse.canaux != 3) {
+            snprintf(reponse.message, sizeof(reponse.message), "réponse invalide");
+            return false;
+        }
+
+        if (!sortie.ouvrir(reponse.segment, (size_t) reponse.rows * reponse.cols * reponse.canaux, false)) {
+            snprintf(reponse.message, sizeof(reponse.message), "segment %s illisible", reponse.segment);
+            return false;
+        }
+        resultat = sortie.image(reponse.rows, reponse.cols, reponse.canaux);
+        return true;
+    }
+
+private:
+    int fd = -1;
+    SegmentPartage entree;
+    SegmentPartage sortie;
+};
+
+#endif //TP_PROTOCOLE_TP_HPP
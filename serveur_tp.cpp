@@ -0,0 +1,277 @@
+#include <csignal>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <sys/stat.h>
+#include "opencv2/imgcodecs.hpp"
+#include "opencv2/imgproc.hpp"
+#include "cache_images.hpp"
+#include "config_execution.hpp"
+#include "filtres_tp2.hpp"
+#include "protocole_tp.hpp"
+#include "traitements_couleur.hpp"
+#include "traitements_gris.hpp"
+
+using namespace cv;
+
+/**
+ * Serveur de traitements : reste résident et exécute les chaînes d'étapes
+ * de main_grey_img et main_tp2 (niveaux de gris) et de main_color_img (BGR)
+ * pour ses clients (protocole_tp.hpp).
+ *
+ * Entre deux requêtes il garde les images décodées, les catalogues d'étapes
+ * (tables, noyaux, palettes) de chaque jeu de paramètres, le pool de threads d'OpenCV et,
+ * par connexion, un MoteurPipeline et son segment de sortie : une requête ne
+ * paie que son traitement. Les images et les catalogues gardés sont limités
+ * (IMAGES_MAX_OCTETS, CHAINES_MAX) : au-delà, les moins récemment utilisés
+ * sont oubliés.
+ *
+ * La socket n'est accessible qu'à l'utilisateur du serveur (0600) : le
+ * serveur lit tout fichier dont un client lui donne le chemin.
+ */
+
+#define IMAGES_MAX_OCTETS ((size_t) 256 << 20)      // pixels des images décodées gardées
+#define CHAINES_MAX 64                              // jeux d'étapes gardés
+
+/** --- ETAT PARTAGE ENTRE LES CONNEXIONS --- **/
+struct ImageChargee {
+    Mat image;          // CV_8UC1 ou CV_8UC3
+    time_t mtime;
+    off_t taille;
+    uint64_t dernierUsage;
+};
+
+struct ChaineConstruite {
+    std::vector<Etape> etapes;
+    uint64_t dernierUsage;
+};
+
+struct EtatServeur {
+    std::mutex verrou;
+    uint64_t horloge = 0;                               // incrémentée à chaque usage
+    std::map<std::string, ImageChargee> images;        // clé : canaux et chemin
+    size_t octetsImages = 0;
+    std::map<std::string, ChaineConstruite> chaines;    // clé : chaîne et paramètres
+};
+
+/* entrée la moins récemment utilisée d'une table non vide */
+template<typename Entree>
+typename std::map<std::string, Entree>::iterator moinsRecente(std::map<std::string, Entree> &table) {
+    auto ancienne = table.begin();
+    for (auto it = table.begin(); it != table.end(); ++it) {
+        if (it->second.dernierUsage < ancienne->second.dernierUsage) ancienne = it;
+    }
+    return ancienne;
+}
+
+/* image du fichier en gris (canaux 1) ou en BGR (3), chargée une seule fois tant que le fichier ne change pas */
+bool imageFichier(EtatServeur &etat, const std::string &chemin, int canaux, Mat &image) {
+    struct stat infos;
+    if (stat(chemin.c_str(), &infos) != 0) return false;
+    const std::string cle = std::to_string(canaux) + "|" + chemin;
+
+    {
+        std::lock_guard<std::mutex> garde(etat.verrou);
+        auto it = etat.images.find(cle);
+        if (it != etat.images.end() && it->second.mtime == infos.st_mtime && it->second.taille == infos.st_size) {
+            it->second.dernierUsage = ++etat.horloge;
+            image = it->second.image;
+            return true;
+        }
+    }
+
+    // chargement hors du verrou : les autres connexions continuent
+    ImageChargee chargee;
+    chargee.image = chargerImage(chemin, canaux == 3 ? IMREAD_COLOR : IMREAD_GRAYSCALE);
+    if (chargee.image.empty()) return false;
+    afficherStatistiquesCache();
+    chargee.mtime = infos.st_mtime;
+    chargee.taille = infos.st_size;
+
+    std::lock_guard<std::mutex> garde(etat.verrou);
+    const size_t octets = chargee.image.total() * chargee.image.elemSize();
+    auto it = etat.images.find(cle);
+    if (it != etat.images.end()) {
+        etat.octetsImages -= it->second.image.total() * it->second.image.elemSize();
+        etat.images.erase(it);
+    }
+    // les images oubliées restent valables pour les connexions qui les traitent (Mat partagée)
+    while (!etat.images.empty() && etat.octetsImages + octets > IMAGES_MAX_OCTETS) {
+        auto ancienne = moinsRecente(etat.images);
+        etat.octetsImages -= ancienne->second.image.total() * ancienne->second.image.elemSize();
+        etat.images.erase(ancienne);
+    }
+    chargee.dernierUsage = ++etat.horloge;
+    etat.images[cle] = chargee;
+    etat.octetsImages += octets;
+    image = chargee.image;
+    return true;
+}
+
+/* étapes de la chaîne pour ces paramètres, construites une seule fois */
+bool etapesChaine(EtatServeur &etat, const RequeteTP &requete, std::vector<Etape> &etapes) {
+    std::string cle = std::to_string(requete.canaux) + "|" + requete.chaine + "|" + std::to_string(requete.alpha)
+                      + "|" + std::to_string(requete.seuil) + "|" + std::to_string(requete.rayon) + "|"
+                      + std::to_string(requete.proportion) + "|" + std::to_string(requete.longueur);
+
+    std::lock_guard<std::mutex> garde(etat.verrou);
+    auto it = etat.chaines.find(cle);
+    if (it != etat.chaines.end()) {
+        it->second.dernierUsage = ++etat.horloge;
+        etapes = it->second.etapes;
+        return true;
+    }
+
+    CatalogueEtapes catalogue;
+    if (requete.canaux == 3) {
+        // étapes de main_color_img (egal, tram, genBGR, genCMYK) : les palettes restent dans la chaîne gardée
+        catalogue = catalogueCouleur();
+    } else {
+        // étapes du TP2 (a, m, s, x, y, g, t, e, n, b) et du TP1 (egal, tram, seuil)
+        catalogue = catalogueTP2(requete.alpha, requete.seuil, requete.rayon, requete.proportion, requete.longueur);
+        CatalogueEtapes gris = catalogueGris(requete.seuil);
+        catalogue.insert(gris.begin(), gris.end());
+    }
+
+    if (!analyserPipeline(requete.chaine, catalogue, etapes)) return false;
+    if (etat.chaines.size() >= CHAINES_MAX) etat.chaines.erase(moinsRecente(etat.chaines));
+    etat.chaines[cle] = {etapes, ++etat.horloge};
+    return true;
+}
+
+/** --- CONNEXION --- **/
+void repondreErreur(int fd, ReponseTP &reponse, const std::string &message) {
+    reponse.statut = 1;
+    snprintf(reponse.message, sizeof(reponse.message), "%s", message.c_str());
+    envoyerTout(fd, &reponse, sizeof(reponse));
+}
+
+void servirClient(EtatServeur &etat, int fd, int numero) {
+    MoteurPipeline moteur;
+    SegmentPartage entree;
+    SegmentPartage sortie;
+    const std::string nomSortie = "/tp_sortie_" + std::to_string(getpid()) + "_" + std::to_string(numero);
+    Mat tamponsCouleur[2];      // intermédiaires des chaînes couleur
+    std::vector<Etape> etapes;
+    Mat resultat;
+    RequeteTP requete;
+
+    while (recevoirTout(fd, &requete, sizeof(requete))) {
+        int64 debut = getTickCount();
+        ReponseTP reponse;
+        requete.chemin[sizeof(requete.chemin) - 1] = 0;
+        requete.chaine[sizeof(requete.chaine) - 1] = 0;
+
+        if (requete.magique != TP_MAGIQUE) {
+            repondreErreur(fd, reponse, "requête invalide");
+            break;
+        }
+        if (requete.canaux != 1 && requete.canaux != 3) {
+            repondreErreur(fd, reponse, "canaux : 1 (niveaux de gris) ou 3 (BGR)");
+            continue;
+        }
+
+        Mat image;
+        if (requete.source == SOURCE_MEMOIRE) {
+            if (requete.rows <= 0 || requete.cols <= 0
+                || !entree.ouvrir(requete.chemin, (size_t) requete.rows * requete.cols * requete.canaux, false)) {
+                repondreErreur(fd, reponse, std::string("segment d'entrée illisible ou plus petit que "
+                                                        "rows x cols x canaux : ") + requete.chemin);
+                continue;
+            }
+            image = entree.image(requete.rows, requete.cols, requete.canaux);
+        } else if (!imageFichier(etat, requete.chemin, requete.canaux, image)) {
+            repondreErreur(fd, reponse, std::string("image illisible : ") + requete.chemin);
+            continue;
+        }
+
+        if (!etapesChaine(etat, requete, etapes)) {
+            repondreErreur(fd, reponse, std::string("chaîne invalide : ") + requete.chaine);
+            continue;
+        }
+
+        // le résultat est écrit directement dans le segment de sortie de la connexion
+        if (!sortie.creer(nomSortie, image.total() * image.elemSize())) {
+            repondreErreur(fd, reponse, "segment de sortie impossible à créer");
+            continue;
+        }
+        resultat = sortie.image(image.rows, image.cols, image.channels());
+        Mat destination = resultat;
+        if (image.channels() == 3) {
+            executerCouleur(etapes, image, destination, tamponsCouleur);
+        } else {
+            moteur.executer(etapes, image, destination);
+        }
+        if (destination.data != resultat.data) destination.copyTo(resultat);
+
+        reponse.rows = image.rows;
+        reponse.cols = image.cols;
+        reponse.canaux = image.channels();
+        snprintf(reponse.segment, sizeof(reponse.segment), "%s", nomSortie.c_str());
+        reponse.dureeMs = (getTickCount() - debut) * 1000.0 / getTickFrequency();
+        if (!envoyerTout(fd, &reponse, sizeof(reponse))) break;
+    }
+    close(fd);
+
+    // le serveur ne s'arrête pas : les compteurs (--perf) sont affichés à chaque fin de connexion
+    afficherCompteursPerf();
+}
+
+/** --- ARRET --- **/
+static char cheminSocketActif[sizeof(sockaddr_un::sun_path)];
+
+/* SIGINT, SIGTERM, SIGHUP : la socket est retirée avant de quitter */
+void arreterServeur(int) {
+    unlink(cheminSocketActif);
+    _exit(0);
+}
+
+/** --- MAIN --- **/
+int main(int argc, char *argv[]) {
+    // threads, affinité et backends (options retirées de argv, config_execution.hpp)
+    configurerExecution(argc, argv);
+
+    std::string cheminSocket = cheminSocketDefaut();
+    for (int i = 1; i < argc; i++) {
+        String option = argv[i];
+        if (option == "--socket" && i + 1 < argc) {
+            cheminSocket = argv[++i];
+        } else {
+            std::cout << "\nUsage : ./serveur_tp [--socket <chemin>]\n" << std::endl;
+            exit(1);
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    sockaddr_un adresse;
+    if (!adresseSocket(cheminSocket, adresse)) {
+        std::cout << "Chemin de socket trop long : " << cheminSocket << std::endl;
+        return 1;
+    }
+    unlink(cheminSocket.c_str());
+    int ecoute = socket(AF_UNIX, SOCK_STREAM, 0);
+    // socket créée directement en 0600 : aucun autre utilisateur ne peut s'y connecter
+    mode_t masque = umask(0077);
+    bool liee = ecoute >= 0 && bind(ecoute, (sockaddr *) &adresse, sizeof(adresse)) == 0;
+    umask(masque);
+    if (!liee || chmod(cheminSocket.c_str(), 0600) < 0 || listen(ecoute, 64) < 0) {
+        perror("serveur_tp");
+        return 1;
+    }
+    snprintf(cheminSocketActif, sizeof(cheminSocketActif), "%s", cheminSocket.c_str());
+    signal(SIGINT, arreterServeur);
+    signal(SIGTERM, arreterServeur);
+    signal(SIGHUP, arreterServeur);
+    std::cout << "serveur_tp en écoute sur " << cheminSocket << " (" << getNumThreads() << " threads)" << std::endl;
+
+    // une connexion par thread ; le traitement d'une requête utilise en plus le pool de threads d'OpenCV
+    EtatServeur etat;
+    int numero = 0;
+    for (;;) {
+        int fd = accept(ecoute, nullptr, nullptr);
+        if (fd < 0) continue;
+        std::thread(servirClient, std::ref(etat), fd, numero++).detach();
+    }
+}
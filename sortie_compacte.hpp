@@ -0,0 +1,176 @@
+#ifndef TP_SORTIE_COMPACTE_HPP
+#define TP_SORTIE_COMPACTE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <zlib.h>
+#include "opencv2/core.hpp"
+
+/**
+ * Images tramées compactées : une image tramée ne prend que quelques
+ * couleurs, on stocke donc l'indice de sa couleur dans une palette sur 1, 4
+ * ou 8 bits par pixel (pixels rangés bit de poids fort en premier, comme en
+ * PNG et en PBM) au lieu de 8 ou 24 bits.
+ */
+
+struct ImageIndexee {
+    cv::Mat indices;                    // rows x octetsParLigne, CV_8UC1
+    int cols = 0;
+    int bitsParPixel = 8;               // 1, 4 ou 8
+    std::vector<cv::Vec3b> palette;     // BGR
+
+    void creer(int rows, int nbCols, int bits, const std::vector<cv::Vec3b> &couleurs) {
+        cols = nbCols;
+        bitsParPixel = bits;
+        palette = couleurs;
+        indices.create(rows, (nbCols * bits + 7) / 8, CV_8UC1);
+        indices.setTo(0);
+    }
+
+    int rows() const {
+        return indices.rows;
+    }
+
+    void ecrire(int ligne, int colonne, int indice) {
+        int bit = colonne * bitsParPixel;
+        int decalage = 8 - bitsParPixel - (bit & 7);
+        uchar masque = (uchar) (((1 << bitsParPixel) - 1) << decalage);
+        uchar &octet = indices.at<uchar>(ligne, bit >> 3);
+        octet = (uchar) ((octet & ~masque) | ((indice << decalage) & masque));
+    }
+
+    int lire(int ligne, int colonne) const {
+        int bit = colonne * bitsParPixel;
+        int decalage = 8 - bitsParPixel - (bit & 7);
+        return (indices.at<uchar>(ligne, bit >> 3) >> decalage) & ((1 << bitsParPixel) - 1);
+    }
+};
+
+/* nombre de bits par pixel suffisant pour une palette de n couleurs */
+inline int bitsPourPalette(size_t n) {
+    return (n <= 2) ? 1 : (n <= 16) ? 4 : 8;
+}
+
+/* palette flottante (0..1, comme pour tramage_floyd_steinberg_generic) vers BGR 8 bits */
+inline std::vector<cv::Vec3b> paletteBGR(const std::vector<cv::Vec3f> &colors) {
+    std::vector<cv::Vec3b> palette;
+    for (size_t i = 0; i < colors.size(); i++) {
+        palette.push_back(cv::Vec3b(cv::saturate_cast<uchar>(colors[i][0] * 255.0),
+                                    cv::saturate_cast<uchar>(colors[i][1] * 255.0),
+                                    cv::saturate_cast<uchar>(colors[i][2] * 255.0)));
+    }
+    return palette;
+}
+
+/** --- AFFICHAGE --- **/
+/* décompacte vers une image BGR pour imshow */
+inline void decompacter(const ImageIndexee &image, cv::Mat &bgr) {
+    bgr.create(image.rows(), image.cols, CV_8UC3);
+    for (int i = 0; i < image.rows(); i++) {
+        cv::Vec3b *ligne = bgr.ptr<cv::Vec3b>(i);
+        for (int j = 0; j < image.cols; j++) {
+            ligne[j] = image.palette[image.lire(i, j)];
+        }
+    }
+}
+
+/** --- FERMETURE --- **/
+/* ferme le fichier ; si une écriture ou la fermeture a échoué (disque plein...), supprime le fichier partiel */
+inline bool fermerFichierSortie(FILE *fichier, const std::string &chemin, bool ok) {
+    ok = (fclose(fichier) == 0) && ok;
+    if (!ok) std::remove(chemin.c_str());
+    return ok;
+}
+
+/** --- ECRITURE PBM (1 bit) --- **/
+/* en PBM un bit à 1 est noir : la palette doit être {noir, blanc} */
+inline bool ecrirePBM(const std::string &chemin, const ImageIndexee &image) {
+    if (image.bitsParPixel != 1) return false;
+
+    FILE *fichier = fopen(chemin.c_str(), "wb");
+    if (fichier == nullptr) return false;
+
+    bool ok = fprintf(fichier, "P4\n%d %d\n", image.cols, image.rows()) > 0;
+    std::vector<uchar> ligne(image.indices.cols);
+    for (int i = 0; ok && i < image.rows(); i++) {
+        const uchar *src = image.indices.ptr<uchar>(i);
+        for (int j = 0; j < image.indices.cols; j++) ligne[j] = (uchar) ~src[j];
+        ok = fwrite(ligne.data(), 1, ligne.size(), fichier) == ligne.size();
+    }
+    return fermerFichierSortie(fichier, chemin, ok);
+}
+
+/** --- ECRITURE PNG A PALETTE (1, 4 ou 8 bits) --- **/
+inline void ajouterEntier32(std::vector<uchar> &octets, uint32_t valeur) {
+    octets.push_back((uchar) (valeur >> 24));
+    octets.push_back((uchar) (valeur >> 16));
+    octets.push_back((uchar) (valeur >> 8));
+    octets.push_back((uchar) valeur);
+}
+
+/* faux si l'écriture a échoué */
+inline bool ecrireBlocPNG(FILE *fichier, const char type[4], const std::vector<uchar> &donnees) {
+    std::vector<uchar> bloc;
+    ajouterEntier32(bloc, (uint32_t) donnees.size());
+    bloc.insert(bloc.end(), type, type + 4);
+    bloc.insert(bloc.end(), donnees.begin(), donnees.end());
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, bloc.data() + 4, (uInt) (bloc.size() - 4));
+    ajouterEntier32(bloc, (uint32_t) crc);
+    return fwrite(bloc.data(), 1, bloc.size(), fichier) == bloc.size();
+}
+
+inline bool ecrirePNG(const std::string &chemin, const ImageIndexee &image) {
+    // lignes brutes précédées de leur type de filtre (0 : aucun), compressées en un seul IDAT
+    const int octetsParLigne = image.indices.cols;
+    std::vector<uchar> brut;
+    brut.reserve((size_t) image.rows() * (octetsParLigne + 1));
+    for (int i = 0; i < image.rows(); i++) {
+        const uchar *ligne = image.indices.ptr<uchar>(i);
+        brut.push_back(0);
+        brut.insert(brut.end(), ligne, ligne + octetsParLigne);
+    }
+    uLongf tailleCompressee = compressBound((uLong) brut.size());
+    std::vector<uchar> compresse(tailleCompressee);
+    if (compress2(compresse.data(), &tailleCompressee, brut.data(), (uLong) brut.size(), 9) != Z_OK) return false;
+    compresse.resize(tailleCompressee);
+
+    std::vector<uchar> entete;
+    ajouterEntier32(entete, (uint32_t) image.cols);
+    ajouterEntier32(entete, (uint32_t) image.rows());
+    entete.push_back((uchar) image.bitsParPixel);
+    entete.push_back(3);    // couleurs indexées
+    entete.push_back(0);    // compression
+    entete.push_back(0);    // filtrage
+    entete.push_back(0);    // pas d'entrelacement
+
+    std::vector<uchar> palette;
+    for (size_t i = 0; i < image.palette.size(); i++) {
+        palette.push_back(image.palette[i][2]);
+        palette.push_back(image.palette[i][1]);
+        palette.push_back(image.palette[i][0]);
+    }
+
+    FILE *fichier = fopen(chemin.c_str(), "wb");
+    if (fichier == nullptr) return false;
+
+    const uchar signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    bool ok = fwrite(signature, 1, 8, fichier) == 8
+              && ecrireBlocPNG(fichier, "IHDR", entete)
+              && ecrireBlocPNG(fichier, "PLTE", palette)
+              && ecrireBlocPNG(fichier, "IDAT", compresse)
+              && ecrireBlocPNG(fichier, "IEND", std::vector<uchar>());
+    return fermerFichierSortie(fichier, chemin, ok);
+}
+
+/* écrit en .pbm ou .png selon l'extension du chemin */
+inline bool ecrireImageIndexee(const std::string &chemin, const ImageIndexee &image) {
+    if (chemin.size() > 4 && chemin.compare(chemin.size() - 4, 4, ".pbm") == 0) {
+        return ecrirePBM(chemin, image);
+    }
+    return ecrirePNG(chemin, image);
+}
+
+#endif //TP_SORTIE_COMPACTE_HPP
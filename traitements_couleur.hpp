@@ -0,0 +1,80 @@
+#ifndef TP_TRAITEMENTS_COULEUR_HPP
+#define TP_TRAITEMENTS_COULEUR_HPP
+
+#include <vector>
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+#include "pipeline.hpp"
+#include "traitements_image.hpp"
+
+/**
+ * Traitements du TP1 sur les images couleur (BGR, CV_8UC3) et leur catalogue
+ * d'étapes, partagés par main_color_img et le serveur de traitements (serveur_tp).
+ *
+ * Les étapes couleur sont toutes globales : le MoteurPipeline, en CV_8UC1,
+ * ne les exécute pas, executerCouleur les enchaîne.
+ */
+
+/** EGALISATION **/
+/* égalisation du canal V en HSV ; hist, histCumule : histogrammes de l'image égalisée */
+inline void egalisation_couleur(const cv::Mat &bgr, cv::Mat &hsv, cv::Mat &sortie, std::vector<double> &hist,
+                                std::vector<double> &histCumule) {
+    cv::cvtColor(bgr, hsv, cv::COLOR_BGR2HSV);
+    histogramme<cv::Vec3b>(hsv, hist);
+    histogramme_cumule(hist, histCumule);
+
+    equalization<cv::Vec3b>(hsv, histCumule, hsv);
+    histogramme<cv::Vec3b>(hsv, hist);
+    histogramme_cumule(hist, histCumule);
+
+    cv::cvtColor(hsv, sortie, cv::COLOR_HSV2BGR);
+}
+
+/** CHAINE DE TRAITEMENTS **/
+/* étapes utilisables dans une chaîne couleur ("egal,genBGR") ; les palettes sont construites ici, une fois */
+inline CatalogueEtapes catalogueCouleur() {
+    CatalogueEtapes catalogue;
+
+    catalogue["egal"] = etapeGlobale("egal", [](const cv::Mat &in, cv::Mat &out) {
+        static thread_local cv::Mat hsv;    // gardés d'une image à l'autre
+        static thread_local std::vector<double> hist, histCumule;
+        egalisation_couleur(in, hsv, out, hist, histCumule);
+    });
+
+    catalogue["tram"] = etapeGlobale("tram", [](const cv::Mat &in, cv::Mat &out) {
+        static thread_local cv::Mat fs;
+        tramage_floyd_steinberg<cv::Vec3b>(in, fs, out);
+    });
+
+    std::vector<cv::Vec3f> paletteBGR = palette_generique_BGR();
+    catalogue["genBGR"] = etapeGlobale("genBGR", [paletteBGR](const cv::Mat &in, cv::Mat &out) {
+        static thread_local cv::Mat fs;
+        tramage_floyd_steinberg_generic(in, paletteBGR, fs, out);
+    });
+
+    std::vector<cv::Vec3f> paletteCMJN = palette_generique_CMJN();
+    catalogue["genCMYK"] = etapeGlobale("genCMYK", [paletteCMJN](const cv::Mat &in, cv::Mat &out) {
+        static thread_local cv::Mat fs;
+        tramage_floyd_steinberg_generic(in, paletteCMJN, fs, out);
+    });
+
+    return catalogue;
+}
+
+/**
+ * Exécute les étapes l'une après l'autre sur entree (CV_8UC3). La dernière
+ * écrit dans sortie, les autres dans tampons, gardés par l'appelant d'une
+ * image à l'autre.
+ */
+inline void executerCouleur(const std::vector<Etape> &etapes, const cv::Mat &entree, cv::Mat &sortie,
+                            cv::Mat tampons[2]) {
+    CV_Assert(entree.type() == CV_8UC3 && !etapes.empty());
+    const cv::Mat *courant = &entree;
+    for (size_t i = 0; i < etapes.size(); i++) {
+        cv::Mat &destination = (i + 1 == etapes.size()) ? sortie : tampons[i % 2];
+        etapes[i].appliquer(*courant, destination);
+        courant = &destination;
+    }
+}
+
+#endif //TP_TRAITEMENTS_COULEUR_HPP
@@ -0,0 +1,82 @@
+#ifndef TP_TRAITEMENTS_GRIS_HPP
+#define TP_TRAITEMENTS_GRIS_HPP
+
+#include <algorithm>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "pipeline.hpp"
+#include "traitements_image.hpp"
+
+/**
+ * Traitements du TP1 sur les images en niveaux de gris et leur catalogue
+ * d'étapes, partagés par main_grey_img et le serveur de traitements (serveur_tp).
+ * Histogrammes, égalisation et tramages complets viennent de traitements_image.
+ */
+
+/** TRAMAGE FLOYD STEINBERG PAR BANDES (mode tuiles) **/
+/* parcours ligne par ligne ; erreur (1 x cols, CV_32FC1) est reportée sur la première ligne de la bande suivante */
+inline void tramage_floyd_steinberg_bande(const cv::Mat &bande, cv::Mat &sortie, cv::Mat &erreur,
+                                          PoolTampons &pool) {
+    if (erreur.empty()) {
+        erreur = cv::Mat::zeros(1, bande.cols, CV_32FC1);
+    }
+
+    // tampon flottant repris à la réserve de l'étage : aucune allocation d'une bande à l'autre
+    cv::Mat fs = pool.obtenir(bande.rows, bande.cols, CV_32FC1);
+    bande.convertTo(fs, CV_32FC1);
+    cv::Mat premiereLigne = fs.row(0);
+    premiereLigne += erreur;
+    erreur.setTo(0.0);
+
+    sortie.create(bande.size(), CV_8UC1);
+
+    // pour chaque ligne de haut en bas
+    for (int x = 0; x < fs.rows; x++) {
+        float *ligne = fs.ptr<float>(x);
+        float *ligneSuivante = (x + 1 < fs.rows) ? fs.ptr<float>(x + 1) : erreur.ptr<float>(0);
+        // pour chaque colonne de gauche à droite
+        for (int y = 0; y < fs.cols; y++) {
+            float ancien_pixel = ligne[y];
+            float nouveau_pixel = (ancien_pixel > 128.0) ? 255.0 : 0.0;
+            sortie.at<uchar>(x, y) = (uchar) nouveau_pixel;
+            float erreur_quantification = ancien_pixel - nouveau_pixel;
+            if (y + 1 < fs.cols) ligne[y + 1] += 7.0 / 16.0 * erreur_quantification;
+            if (y > 0) ligneSuivante[y - 1] += 3.0 / 16.0 * erreur_quantification;
+            ligneSuivante[y] += 5.0 / 16.0 * erreur_quantification;
+            if (y + 1 < fs.cols) ligneSuivante[y + 1] += 1.0 / 16.0 * erreur_quantification;
+        }
+    }
+    pool.rendre(fs);
+}
+
+/** CHAINE DE TRAITEMENTS **/
+/* étapes utilisables dans une chaîne ("egal,tram") */
+inline CatalogueEtapes catalogueGris(int seuil) {
+    CatalogueEtapes catalogue;
+
+    // égalisation : table 255 * H_I calculée sur l'histogramme courant
+    catalogue["egal"] = etapeHistogramme("egal", [](const std::vector<double> &h_I) -> cv::Mat {
+        std::vector<double> H_I;
+        histogramme_cumule(h_I, H_I);
+        cv::Mat lut(1, 256, CV_8UC1);
+        for (int i = 0; i < 256; i++) {
+            lut.at<uchar>(i) = 255.0 * H_I[i];
+        }
+        return lut;
+    });
+
+    catalogue["tram"] = etapeGlobale("tram", [](const cv::Mat &in, cv::Mat &out) {
+        static thread_local cv::Mat fs;     // gardé d'une image à l'autre
+        tramage_floyd_steinberg<uchar>(in, fs, out);
+    }, tramage_floyd_steinberg_bande);
+
+    cv::Mat binarisation(1, 256, CV_8UC1);
+    for (int i = 0; i < 256; i++) {
+        binarisation.at<uchar>(i) = (i > seuil) ? 255 : 0;
+    }
+    catalogue["seuil"] = etapePonctuelle("seuil", binarisation);
+
+    return catalogue;
+}
+
+#endif //TP_TRAITEMENTS_GRIS_HPP
@@ -0,0 +1,458 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include "opencv2/core.hpp"
+#include "compteurs_perf.hpp"
+#include "traitements_image.hpp"
+
+using namespace cv;
+
+/** --- ACCES AU CANAL TRAITE --- **/
+/* niveau de gris, ou canal V d'un pixel HSV */
+inline uchar luminance(uchar pixel) {
+    return pixel;
+}
+
+inline uchar luminance(const Vec3b &pixel) {
+    return pixel[2];
+}
+
+inline void fixerLuminance(uchar &pixel, uchar valeur) {
+    pixel = valeur;
+}
+
+inline void fixerLuminance(Vec3b &pixel, uchar valeur) {
+    pixel[2] = valeur;
+}
+
+/** HISTOGRAMME **/
+template<typename Pixel>
+void histogramme(const Mat &image, std::vector<double> &histogramme) {
+    CV_Assert(image.type() == DataType<Pixel>::type);
+    MesurePerf mesure("histogramme", (double) image.total());
+    histogramme.assign(256, 0.0);
+
+    for (int i = 0; i < image.rows; i++) {
+        const Pixel *ligne = image.ptr<Pixel>(i);
+        for (int j = 0; j < image.cols; j++) {
+            histogramme[luminance(ligne[j])]++;
+        }
+    }
+
+    for (size_t i = 0; i < histogramme.size(); i++) {
+        histogramme[i] = histogramme[i] / (image.rows * image.cols);
+    }
+}
+
+/** HISTOGRAMME CUMULE **/
+void histogramme_cumule(const std::vector<double> &h_I, std::vector<double> &H_I) {
+    H_I.resize(h_I.size());
+
+    for (size_t i = 0; i < h_I.size(); i++) {
+        if (i == 0) {
+            H_I[i] = h_I[i];
+        } else {
+            H_I[i] = h_I[i] + H_I[i - 1];
+        }
+    }
+}
+
+/** AFFICHAGE DES DEUX HISTOGRAMMES **/
+/* même hauteur que le dessin pixel par pixel : ceil(valeur * rows / max) */
+static void calculerHauteurs(const std::vector<double> &histogramme, int rows, int *hauteurs) {
+    double maxValue = *std::max_element(histogramme.begin(), histogramme.end());
+    for (size_t i = 0; i < histogramme.size(); i++) {
+        double hauteur = (maxValue > 0.0) ? std::ceil(histogramme[i] * rows / maxValue) : 0.0;
+        hauteurs[i] = std::min(rows, std::max(0, (int) hauteur));
+    }
+}
+
+void RenduHistogrammes::dessiner(const std::vector<double> &h_I, const std::vector<double> &H_I, Mat &image) {
+    const int rows = 256;
+    nouvelles.create(1, (int) (h_I.size() + H_I.size()), CV_32SC1);
+    calculerHauteurs(h_I, rows, nouvelles.ptr<int>());
+    calculerHauteurs(H_I, rows, nouvelles.ptr<int>() + h_I.size());
+
+    if (image.rows != rows || image.cols != nouvelles.cols || image.type() != CV_8UC1
+        || hauteurs.size() != nouvelles.size()) {
+        // dessin complet : blanc au-dessus de la barre, noir dessous
+        image.create(rows, nouvelles.cols, CV_8UC1);
+        for (int r = 0; r < rows; r++) {
+            Mat ligne = image.row(r);
+            compare(nouvelles, Scalar(rows - 1 - r), ligne, CMP_LE);
+        }
+    } else {
+        // seulement les colonnes qui ont changé
+        const int *avant = hauteurs.ptr<int>();
+        const int *apres = nouvelles.ptr<int>();
+        for (int i = 0; i < nouvelles.cols; i++) {
+            if (avant[i] < apres[i]) {
+                image.rowRange(rows - apres[i], rows - avant[i]).col(i).setTo(0);
+            } else if (avant[i] > apres[i]) {
+                image.rowRange(rows - avant[i], rows - apres[i]).col(i).setTo(255);
+            }
+        }
+    }
+    nouvelles.copyTo(hauteurs);
+}
+
+void afficheHistogrammes(const std::vector<double> &h_I, const std::vector<double> &H_I, Mat &image) {
+    RenduHistogrammes rendu;
+    image.release();
+    rendu.dessiner(h_I, H_I, image);
+}
+
+/** EGALISATION **/
+template<typename Pixel>
+void equalization(const Mat &image, const std::vector<double> &H_I, Mat &sortie) {
+    CV_Assert(image.type() == DataType<Pixel>::type && H_I.size() == 256);
+    MesurePerf mesure("equalization", (double) image.total());
+
+    // table des 256 niveaux, calculée une fois pour toute l'image
+    uchar table[256];
+    for (int v = 0; v < 256; v++) {
+        table[v] = (uchar) (255.0 * (double) H_I[v]);
+    }
+
+    sortie.create(image.size(), image.type());
+    for (int i = 0; i < image.rows; i++) {
+        const Pixel *ligne = image.ptr<Pixel>(i);
+        Pixel *ligneSortie = sortie.ptr<Pixel>(i);
+        for (int j = 0; j < image.cols; j++) {
+            Pixel pixel = ligne[j];
+            fixerLuminance(pixel, table[luminance(pixel)]);
+            ligneSortie[j] = pixel;
+        }
+    }
+}
+
+/** TRAMAGE FLOYD STEINBERG **/
+/**
+ * Une seule boucle de Floyd Steinberg pour tous les tramages complets,
+ * paramétrée par le type de pixel, la quantification (binaire par canal ou
+ * palette) et l'écriture de chaque pixel (image ou indices compactés).
+ *
+ * Parcours colonne par colonne, de haut en bas dans chaque colonne. Les
+ * pixels du bord (première et dernière ligne, dernière colonne) ne sont pas
+ * quantifiés dans fs et ne propagent rien : l'écriture reçoit leur valeur
+ * d'origine, avec l'indice de la couleur la plus proche.
+ */
+
+/* chaque canal en noir (0) ou blanc (255) ; indice : un bit par canal (b + 2g + 4r en couleur) */
+template<int cn>
+struct QuantificationBinaire {
+    const float facteur = 1.0;      // fs est à l'échelle de l'image
+
+    int operator()(float *valeur) const {
+        int indice = 0;
+        for (int n = 0; n < cn; n++) {
+            valeur[n] = (valeur[n] > 128.0) ? 255.0 : 0.0;
+            if (valeur[n] > 0.0) indice |= (1 << n);
+        }
+        return indice;
+    }
+};
+
+/* couleur de colors la plus proche ; indice : position dans colors */
+struct QuantificationPalette {
+    explicit QuantificationPalette(const std::vector<Vec3f> &colors) : colors(colors) {
+        CV_Assert(!colors.empty());
+    }
+
+    const std::vector<Vec3f> &colors;
+    const float facteur = 255.0;    // fs est entre 0 et 1, comme la palette
+
+    int operator()(float *valeur) const {
+        int i = best_color(Vec3f(valeur[0], valeur[1], valeur[2]), colors);
+        for (int n = 0; n < 3; n++) valeur[n] = colors[i][n];
+        return i;
+    }
+};
+
+/* image du type de l'entrée */
+template<typename Pixel>
+struct EcritureImage {
+    Mat &output;
+    float facteur;
+
+    void operator()(int x, int y, const float *valeur, int) const {
+        const int cn = DataType<Pixel>::channels;
+        uchar *pixel = output.ptr<uchar>(x) + y * cn;
+        for (int n = 0; n < cn; n++) pixel[n] = saturate_cast<uchar>(valeur[n] * facteur);
+    }
+};
+
+/* indices compactés */
+struct EcritureIndexee {
+    ImageIndexee &output;
+
+    void operator()(int x, int y, const float *, int indice) const {
+        output.ecrire(x, y, indice);
+    }
+};
+
+template<typename Pixel, typename Quantification, typename Ecriture>
+static void floydSteinberg(const Mat &input, const Quantification &quantification, Mat &fs,
+                           const Ecriture &ecriture) {
+    const int cn = DataType<Pixel>::channels;
+    CV_Assert(input.type() == DataType<Pixel>::type);
+    input.convertTo(fs, CV_MAKETYPE(CV_32F, cn), 1.0 / quantification.facteur);
+
+    // pour chaque x de gauche à droite
+    for (int y = 0; y < fs.cols; y++) {
+        // pour chaque y de haut en bas (les canaux sont indépendants)
+        for (int x = 0; x < fs.rows; x++) {
+            float *pixel = fs.ptr<float>(x) + y * cn;
+            float nouveau_pixel[cn];
+            std::copy(pixel, pixel + cn, nouveau_pixel);
+            const int indice = quantification(nouveau_pixel);
+
+            if (y == fs.cols - 1 || x == 0 || x == fs.rows - 1) {
+                ecriture(x, y, pixel, indice);
+                continue;
+            }
+
+            float *dessus = fs.ptr<float>(x - 1) + y * cn;
+            float *dessous = fs.ptr<float>(x + 1) + y * cn;
+            for (int n = 0; n < cn; n++) {
+                float erreur_quantification = pixel[n] - nouveau_pixel[n];
+                pixel[n] = nouveau_pixel[n];
+                dessous[n] += 7.0 / 16.0 * erreur_quantification;
+                dessus[cn + n] += 3.0 / 16.0 * erreur_quantification;
+                pixel[cn + n] += 5.0 / 16.0 * erreur_quantification;
+                dessous[cn + n] += 1.0 / 16.0 * erreur_quantification;
+            }
+            ecriture(x, y, pixel, indice);
+        }
+    }
+}
+
+template<typename Pixel>
+void tramage_floyd_steinberg(const Mat &input, Mat &fs, Mat &output) {
+    MesurePerf mesure("tramage_floyd_steinberg", (double) input.total());
+    output.create(input.size(), input.type());
+    QuantificationBinaire<DataType<Pixel>::channels> quantification;
+    floydSteinberg<Pixel>(input, quantification, fs, EcritureImage<Pixel>{output, quantification.facteur});
+}
+
+std::vector<Vec3b> palette_coins_BGR() {
+    std::vector<Vec3b> palette;
+    for (int i = 0; i < 8; i++) {
+        palette.push_back(Vec3b((i & 1) ? 255 : 0, (i & 2) ? 255 : 0, (i & 4) ? 255 : 0));
+    }
+    return palette;
+}
+
+template<typename Pixel>
+void tramage_floyd_steinberg_indexe(const Mat &input, Mat &fs, ImageIndexee &output) {
+    MesurePerf mesure("tramage_floyd_steinberg_indexe", (double) input.total());
+    const int cn = DataType<Pixel>::channels;
+    if (cn == 1) {
+        output.creer(input.rows, input.cols, 1, {Vec3b(0, 0, 0), Vec3b(255, 255, 255)});
+    } else {
+        output.creer(input.rows, input.cols, 4, palette_coins_BGR());
+    }
+    floydSteinberg<Pixel>(input, QuantificationBinaire<cn>(), fs, EcritureIndexee{output});
+}
+
+/** TRAMAGE GENERIQUE **/
+float distance_color_l2(Vec3f bgr1, Vec3f bgr2) {
+    return sqrt(
+            (bgr1[0] - bgr2[0]) * (bgr1[0] - bgr2[0])
+            + (bgr1[1] - bgr2[1]) * (bgr1[1] - bgr2[1])
+            + (bgr1[2] - bgr2[2]) * (bgr1[2] - bgr2[2]));
+}
+
+int best_color(Vec3f bgr, const std::vector<Vec3f> &colors) {
+    int i = -1;
+    float minDist = INFINITY;
+
+    for (size_t n = 0; n < colors.size(); n++) {
+        float dist = distance_color_l2(bgr, colors[n]);
+        if (dist < minDist) {
+            i = (int) n;
+            minDist = dist;
+        }
+    }
+
+    return i;
+}
+
+Vec3f error_color(Vec3f bgr1, Vec3f bgr2) {
+    return {bgr1[0] - bgr2[0], bgr1[1] - bgr2[1], bgr1[2] - bgr2[2]};
+}
+
+void tramage_floyd_steinberg_generic(const Mat &input, const std::vector<Vec3f> &colors, Mat &fs, Mat &output) {
+    MesurePerf mesure("tramage_floyd_steinberg_generic", (double) input.total());
+    output.create(input.size(), CV_8UC3);
+    QuantificationPalette quantification(colors);
+    floydSteinberg<Vec3b>(input, quantification, fs, EcritureImage<Vec3b>{output, quantification.facteur});
+}
+
+void tramage_floyd_steinberg_generic_indexe(const Mat &input, const std::vector<Vec3f> &colors, Mat &fs,
+                                            ImageIndexee &output) {
+    MesurePerf mesure("tramage_floyd_steinberg_generic_indexe", (double) input.total());
+    output.creer(input.rows, input.cols, bitsPourPalette(colors.size()), paletteBGR(colors));
+    floydSteinberg<Vec3b>(input, QuantificationPalette(colors), fs, EcritureIndexee{output});
+}
+
+std::vector<Vec3f> palette_generique_BGR() {
+    Vec3f blue({1.0, 0.0, 0.0});
+    Vec3f green({0.0, 1.0, 0.0});
+    Vec3f red({0.0, 0.0, 1.0});
+    Vec3f black({0.0, 0.0, 0.0});
+    Vec3f white({1.0, 1.0, 1.0});
+    return {blue, green, red, black, white};
+}
+
+std::vector<Vec3f> palette_generique_CMJN() {
+    Vec3f cyan({1.0, 1.0, 0.0});
+    Vec3f magenta({1.0, 0.0, 1.0});
+    Vec3f yellow({0.0, 1.0, 1.0});
+    Vec3f black({0.0, 0.0, 0.0});
+    Vec3f white({1.0, 1.0, 1.0});
+    return {cyan, magenta, yellow, black, white};
+}
+
+/** TRAMAGE INCREMENTAL **/
+/**
+ * Même parcours et mêmes coefficients que floydSteinberg, mais chaque pixel
+ * "tire" l'erreur de ses voisins déjà traités au lieu de la pousser : il
+ * suffit de garder l'erreur de quantification de chaque pixel pour retramer
+ * un bloc seul.
+ */
+template<typename Pixel, typename Quantification>
+static void floydSteinbergIncremental(const Mat &input, const Quantification &quantification,
+                                      EtatTramageIncremental &etat) {
+    const int cn = DataType<Pixel>::channels;
+    const int rows = input.rows;
+    const int cols = input.cols;
+    const int B = etat.tailleBloc;
+    const int nbBlocsLignes = etat.aRetramer.rows;
+    const float echelle = 1 / quantification.facteur;
+    const float coefficients[4] = {1.0 / 16.0, 5.0 / 16.0, 3.0 / 16.0, 7.0 / 16.0};
+
+    // colonne par colonne, de haut en bas dans chaque colonne
+    for (int y = 0; y < cols; y++) {
+        const uchar *blocs = etat.aRetramer.ptr<uchar>() + y / B;
+        for (int bx = 0; bx < nbBlocsLignes; bx++) {
+            if (!blocs[bx * etat.aRetramer.step]) continue;
+
+            for (int x = bx * B; x < std::min(rows, (bx + 1) * B); x++) {
+                const uchar *p = input.ptr<uchar>(x) + y * cn;
+                float v[cn];
+                for (int n = 0; n < cn; n++) v[n] = p[n] * echelle;
+
+                // erreurs reçues des pixels déjà traités, dans l'ordre où elles auraient été poussées
+                const float *voisins[4] = {
+                        (y > 0 && x > 0) ? etat.erreur.ptr<float>(x - 1) + (y - 1) * cn : nullptr,
+                        (y > 0) ? etat.erreur.ptr<float>(x) + (y - 1) * cn : nullptr,
+                        (y > 0 && x < rows - 1) ? etat.erreur.ptr<float>(x + 1) + (y - 1) * cn : nullptr,
+                        (x > 0) ? etat.erreur.ptr<float>(x - 1) + y * cn : nullptr};
+                for (int k = 0; k < 4; k++) {
+                    if (voisins[k] == nullptr) continue;
+                    for (int n = 0; n < cn; n++) v[n] += coefficients[k] * voisins[k][n];
+                }
+
+                // les bords ne sont pas quantifiés et ne propagent rien, comme pour le tramage complet
+                float q[cn];
+                std::copy(v, v + cn, q);
+                if (y < cols - 1 && x > 0 && x < rows - 1) quantification(q);
+
+                float *erreur = etat.erreur.ptr<float>(x) + y * cn;
+                uchar *sortie = etat.sortie.ptr<uchar>(x) + y * cn;
+                for (int n = 0; n < cn; n++) {
+                    erreur[n] = v[n] - q[n];
+                    sortie[n] = saturate_cast<uchar>(q[n] * quantification.facteur);
+                }
+            }
+        }
+    }
+}
+
+template<typename Pixel>
+void tramage_floyd_steinberg_incremental(const Mat &input, const std::vector<Vec3f> &colors,
+                                         EtatTramageIncremental &etat, Mat &output) {
+    const int cn = DataType<Pixel>::channels;
+    CV_Assert(input.type() == DataType<Pixel>::type && (colors.empty() || cn == 3));
+    MesurePerf mesure("tramage_floyd_steinberg_incremental", (double) input.total());
+    const int rows = input.rows;
+    const int cols = input.cols;
+    const int B = etat.tailleBloc;
+    const int nbBlocsLignes = (rows + B - 1) / B;
+    const int nbBlocsColonnes = (cols + B - 1) / B;
+
+    // Blocs à retramer : tous à la première image, sinon ceux qui ont changé et leur voisinage
+    if (etat.precedente.size() != input.size() || etat.precedente.type() != input.type()) {
+        etat.erreur.create(rows, cols, CV_MAKETYPE(CV_32F, cn));
+        etat.erreur.setTo(0);
+        etat.sortie.create(rows, cols, input.type());
+        etat.aRetramer.create(nbBlocsLignes, nbBlocsColonnes, CV_8UC1);
+        etat.aRetramer.setTo(1);
+    } else {
+        // différence cumulée de chaque bloc, ligne de blocs par ligne de blocs, dans des tampons gardés
+        etat.sommes.create(1, nbBlocsColonnes, CV_32SC1);
+        etat.modifies.create(nbBlocsLignes, nbBlocsColonnes, CV_8UC1);
+        int *sommes = etat.sommes.ptr<int>();
+        for (int bx = 0; bx < nbBlocsLignes; bx++) {
+            const int finLignes = std::min(rows, (bx + 1) * B);
+            std::fill(sommes, sommes + nbBlocsColonnes, 0);
+            for (int x = bx * B; x < finLignes; x++) {
+                const uchar *a = input.ptr<uchar>(x);
+                const uchar *b = etat.precedente.ptr<uchar>(x);
+                for (int by = 0; by < nbBlocsColonnes; by++) {
+                    int somme = 0;
+                    for (int i = by * B * cn; i < std::min(cols, (by + 1) * B) * cn; i++) {
+                        somme += std::abs(a[i] - b[i]);
+                    }
+                    sommes[by] += somme;
+                }
+            }
+            uchar *modifies = etat.modifies.ptr<uchar>(bx);
+            for (int by = 0; by < nbBlocsColonnes; by++) {
+                const int aire = (finLignes - bx * B) * std::min(B, cols - by * B);
+                modifies[by] = ((double) sommes[by] / aire > etat.seuil) ? 1 : 0;
+            }
+        }
+
+        // dilatation de marge blocs (fenêtre carrée, comme dilate avec marge itérations d'un noyau 3x3)
+        const int m = etat.marge;
+        for (int bx = 0; bx < nbBlocsLignes; bx++) {
+            uchar *aRetramer = etat.aRetramer.ptr<uchar>(bx);
+            for (int by = 0; by < nbBlocsColonnes; by++) {
+                uchar voisin = 0;
+                for (int i = std::max(0, bx - m); i <= std::min(nbBlocsLignes - 1, bx + m) && !voisin; i++) {
+                    const uchar *modifies = etat.modifies.ptr<uchar>(i);
+                    for (int j = std::max(0, by - m); j <= std::min(nbBlocsColonnes - 1, by + m); j++) {
+                        voisin |= modifies[j];
+                    }
+                }
+                aRetramer[by] = voisin;
+            }
+        }
+    }
+    input.copyTo(etat.precedente);
+
+    if (colors.empty()) {
+        floydSteinbergIncremental<Pixel>(input, QuantificationBinaire<cn>(), etat);
+    } else {
+        floydSteinbergIncremental<Pixel>(input, QuantificationPalette(colors), etat);
+    }
+
+    etat.proportionRetramee = (double) countNonZero(etat.aRetramer) / etat.aRetramer.total();
+    etat.sortie.copyTo(output);
+}
+
+/** --- INSTANCIATIONS : niveaux de gris et couleur --- **/
+template void histogramme<uchar>(const Mat &, std::vector<double> &);
+template void histogramme<Vec3b>(const Mat &, std::vector<double> &);
+template void equalization<uchar>(const Mat &, const std::vector<double> &, Mat &);
+template void equalization<Vec3b>(const Mat &, const std::vector<double> &, Mat &);
+template void tramage_floyd_steinberg<uchar>(const Mat &, Mat &, Mat &);
+template void tramage_floyd_steinberg<Vec3b>(const Mat &, Mat &, Mat &);
+template void tramage_floyd_steinberg_indexe<uchar>(const Mat &, Mat &, ImageIndexee &);
+template void tramage_floyd_steinberg_indexe<Vec3b>(const Mat &, Mat &, ImageIndexee &);
+template void tramage_floyd_steinberg_incremental<uchar>(const Mat &, const std::vector<Vec3f> &,
+                                                         EtatTramageIncremental &, Mat &);
+template void tramage_floyd_steinberg_incremental<Vec3b>(const Mat &, const std::vector<Vec3f> &,
+                                                         EtatTramageIncremental &, Mat &);
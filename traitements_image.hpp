@@ -0,0 +1,121 @@
+#ifndef TP_TRAITEMENTS_IMAGE_HPP
+#define TP_TRAITEMENTS_IMAGE_HPP
+
+#include <vector>
+#include "opencv2/core.hpp"
+#include "sortie_compacte.hpp"
+
+/**
+ * Traitements du TP1 communs à tous les programmes, compilés une seule fois
+ * dans la bibliothèque partagée traitements_image (CMakeLists.txt).
+ *
+ * Les entrées sont constantes et jamais modifiées ; les résultats sont écrits
+ * dans des objets fournis par l'appelant (create : rien n'est alloué quand ils
+ * ont déjà la bonne taille). Les versions niveaux de gris et couleur sont
+ * choisies à la compilation par le type de pixel :
+ *  - uchar : image CV_8UC1 ;
+ *  - cv::Vec3b : image CV_8UC3, en HSV pour l'histogramme et l'égalisation
+ *    (canal V), en BGR pour le tramage.
+ *
+ * Tous les tramages de Floyd Steinberg (image, indices compactés, palette,
+ * incrémental) partagent la même boucle et les mêmes quantifications.
+ */
+
+/** HISTOGRAMME **/
+/* histogramme normalisé (256 cases) des niveaux de gris, ou du canal V */
+template<typename Pixel>
+void histogramme(const cv::Mat &image, std::vector<double> &histogramme);
+
+/** HISTOGRAMME CUMULE **/
+void histogramme_cumule(const std::vector<double> &h_I, std::vector<double> &H_I);
+
+/** AFFICHAGE DES DEUX HISTOGRAMMES **/
+/**
+ * Image 256 x 512 des deux histogrammes, barres noires sur fond blanc.
+ * La hauteur de chaque colonne est gardée d'un dessin à l'autre : seules les
+ * colonnes dont la hauteur a changé sont retouchées, sur la différence de
+ * hauteur. Le premier dessin compare, ligne par ligne, les 512 hauteurs au
+ * niveau de la ligne (compare, vectorisé par OpenCV).
+ */
+class RenduHistogrammes {
+public:
+    void dessiner(const std::vector<double> &h_I, const std::vector<double> &H_I, cv::Mat &image);
+
+private:
+    cv::Mat hauteurs;       // 1 x 512, CV_32SC1 : nombre de pixels noirs de chaque colonne
+    cv::Mat nouvelles;
+};
+
+/* dessin complet, sans mémoire d'un dessin précédent */
+void afficheHistogrammes(const std::vector<double> &h_I, const std::vector<double> &H_I, cv::Mat &image);
+
+/** EGALISATION **/
+/* sortie = image égalisée par l'histogramme cumulé H_I (sortie peut être image) */
+template<typename Pixel>
+void equalization(const cv::Mat &image, const std::vector<double> &H_I, cv::Mat &sortie);
+
+/** TRAMAGE FLOYD STEINBERG **/
+/* chaque canal en noir ou blanc ; fs : tampon flottant de la taille de input, output : type de input */
+template<typename Pixel>
+void tramage_floyd_steinberg(const cv::Mat &input, cv::Mat &fs, cv::Mat &output);
+
+/* palette des 8 couleurs obtenues par tramage binaire de chaque canal : indice = b + 2g + 4r */
+std::vector<cv::Vec3b> palette_coins_BGR();
+
+/* même tramage, chaque pixel écrit comme indice : 1 bit (noir, blanc) en gris, 4 bits (palette_coins_BGR) en BGR */
+template<typename Pixel>
+void tramage_floyd_steinberg_indexe(const cv::Mat &input, cv::Mat &fs, ImageIndexee &output);
+
+/** TRAMAGE GENERIQUE **/
+/* distance entre deux couleurs */
+float distance_color_l2(cv::Vec3f bgr1, cv::Vec3f bgr2);
+
+/* indice de la couleur de colors la plus proche de bgr */
+int best_color(cv::Vec3f bgr, const std::vector<cv::Vec3f> &colors);
+
+/* vecteur d'erreur entre deux couleurs */
+cv::Vec3f error_color(cv::Vec3f bgr1, cv::Vec3f bgr2);
+
+/* tramage BGR sur la palette colors (composantes entre 0 et 1) ; fs : tampon CV_32FC3, output : CV_8UC3 */
+void tramage_floyd_steinberg_generic(const cv::Mat &input, const std::vector<cv::Vec3f> &colors, cv::Mat &fs,
+                                     cv::Mat &output);
+
+/* même tramage, chaque pixel écrit comme indice dans colors */
+void tramage_floyd_steinberg_generic_indexe(const cv::Mat &input, const std::vector<cv::Vec3f> &colors,
+                                            cv::Mat &fs, ImageIndexee &output);
+
+/* palettes de genBGR (bleu, vert, rouge, noir, blanc) et de genCMYK (cyan, magenta, jaune, noir, blanc) */
+std::vector<cv::Vec3f> palette_generique_BGR();
+std::vector<cv::Vec3f> palette_generique_CMJN();
+
+/** TRAMAGE INCREMENTAL **/
+/**
+ * Tramage d'une vidéo où seules les zones qui ont bougé sont retramées.
+ *
+ * L'image est découpée en blocs ; un bloc est modifié quand sa différence
+ * moyenne avec l'image précédente dépasse seuil. Les blocs modifiés, élargis
+ * de marge blocs pour laisser l'erreur se propager, sont retramés ; les autres
+ * gardent leur sortie et leur erreur de l'image précédente, ce qui supprime
+ * aussi le scintillement des zones immobiles. Une fois la première image
+ * tramée, rien n'est alloué tant que la taille ne change pas (output compris,
+ * s'il a déjà la bonne taille).
+ */
+struct EtatTramageIncremental {
+    int tailleBloc = 16;
+    double seuil = 6.0;             // différence moyenne par pixel, somme des canaux
+    int marge = 1;                  // en blocs
+    cv::Mat precedente;             // entrée de l'image précédente
+    cv::Mat erreur;                 // erreur de quantification de chaque pixel, flottante (0 sur les bords)
+    cv::Mat sortie;                 // image tramée précédente
+    cv::Mat sommes;                 // différences cumulées d'une ligne de blocs, CV_32SC1
+    cv::Mat modifies;               // un octet par bloc
+    cv::Mat aRetramer;              // modifies élargi de marge blocs
+    double proportionRetramee = 0.0;
+};
+
+/* colors vide : comme tramage_floyd_steinberg, sinon (BGR) comme tramage_floyd_steinberg_generic */
+template<typename Pixel>
+void tramage_floyd_steinberg_incremental(const cv::Mat &input, const std::vector<cv::Vec3f> &colors,
+                                         EtatTramageIncremental &etat, cv::Mat &output);
+
+#endif //TP_TRAITEMENTS_IMAGE_HPP